@@ -0,0 +1,287 @@
+// Benchmarks showq's report pipeline against synthetic queues of various sizes and shapes,
+// reporting the cost of each stage per job and the peak RSS of each run.
+//
+//     make bench
+//     ./showq_bench [jobs ...]
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "fcntl.h"
+#include "sys/resource.h"
+#include "sys/wait.h"
+#include "unistd.h"
+
+#include "slurm/slurm.h"
+
+#include "job_table.hpp"
+#include "report.hpp"
+
+
+// The shape of a synthetic queue
+struct Dataset {
+    const char *name;
+    unsigned users;
+    unsigned partitions;
+    bool heavy_tail;  // Pareto-distributed node counts rather than mostly single-node jobs
+};
+
+
+static const Dataset DATASETS[] = {
+    {"uniform", 200, 8, false},
+    {"many-users", 20000, 8, false},
+    {"many-partitions", 200, 500, false},
+    {"heavy-tail", 200, 8, true},
+};
+
+static const unsigned CLUSTER_NODES = 8000;
+
+
+// A job and partition table shaped like the ones libslurm returns
+class SyntheticQueue {
+public:
+    SyntheticQueue(const Dataset& ds, unsigned count) {
+        std::mt19937 rng(count);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::time_t now = std::time(nullptr);
+
+        static const char *qos[] = {"normal", "high", "long", "debug"};
+        static const uint32_t reasons[] = {
+            WAIT_PRIORITY, WAIT_RESOURCES, WAIT_DEPENDENCY, WAIT_HELD_USER, WAIT_TIME,
+        };
+        for (unsigned i = 0; i < ds.partitions; i++) partition_names_.push_back("part" + std::to_string(i));
+        for (unsigned i = 0; i < 50; i++) accounts_.push_back("account" + std::to_string(i));
+        for (unsigned i = 0; i < 100; i++) names_.push_back("job_script_" + std::to_string(i) + ".sh");
+
+        // Each partition owns a contiguous slice of the cluster's nodes
+        unsigned slice = CLUSTER_NODES / ds.partitions;
+        inx_.reserve(3 * (count + ds.partitions));
+        parts_.resize(ds.partitions);
+        for (unsigned p = 0; p < ds.partitions; p++) {
+            partition_info_t& part = parts_[p];
+            std::memset(&part, 0, sizeof(part));
+            part.name = &partition_names_[p][0];
+            part.nodes = hostlist(p * slice, (p + 1) * slice - 1);
+            part.node_inx = node_inx(p * slice, (p + 1) * slice - 1);
+            part.total_nodes = slice;
+        }
+
+        jobs_.resize(count);
+        for (unsigned i = 0; i < count; i++) {
+            job_info_t& job = jobs_[i];
+            std::memset(&job, 0, sizeof(job));
+            unsigned p = rng() % ds.partitions;
+            job.job_id = 1000000 + i;
+            job.array_task_id = NO_VAL;
+            job.user_id = 10000 + rng() % ds.users;
+            job.group_id = 20000 + job.user_id % 50;
+            job.name = &names_[rng() % names_.size()][0];
+            job.partition = &partition_names_[p][0];
+            job.account = &accounts_[rng() % accounts_.size()][0];
+            job.qos = const_cast<char *>(qos[rng() % 4]);
+            job.priority = rng() % 100000;
+            job.time_limit = 30 + rng() % 2880;
+            job.num_nodes = 1;
+            if (ds.heavy_tail) {
+                job.num_nodes = std::min<double>(slice, 1.0 / std::pow(1.0 - unit(rng), 1.0 / 1.1));
+            }
+            job.num_tasks = job.num_nodes * (1 + rng() % 32);
+            job.num_cpus = job.num_tasks;
+            job.submit_time = now - rng() % 200000;
+            job.eligible_time = job.submit_time + rng() % 600;
+
+            double state = unit(rng);
+            if (state < 0.4) {
+                unsigned first = p * slice + rng() % (slice - job.num_nodes + 1);
+                job.job_state = JOB_RUNNING;
+                job.start_time = job.eligible_time + rng() % 3600;
+                job.end_time = job.start_time + job.time_limit * 60;
+                job.nodes = hostlist(first, first + job.num_nodes - 1);
+                job.node_inx = node_inx(first, first + job.num_nodes - 1);
+                job.batch_host = job.nodes;
+            } else if (state < 0.75) {
+                job.job_state = JOB_PENDING;
+                job.state_reason = reasons[rng() % 5];
+            } else {
+                job.job_state = JOB_COMPLETE + rng() % 3;
+                job.start_time = job.eligible_time + rng() % 3600;
+                job.end_time = job.start_time + rng() % 7200;
+                job.nodes = hostlist(p * slice, p * slice);
+                job.batch_host = job.nodes;
+            }
+        }
+
+        std::memset(&job_msg_, 0, sizeof(job_msg_));
+        job_msg_.record_count = jobs_.size();
+        job_msg_.job_array = jobs_.data();
+        std::memset(&part_msg_, 0, sizeof(part_msg_));
+        part_msg_.record_count = parts_.size();
+        part_msg_.partition_array = parts_.data();
+    }
+
+    const job_info_msg_t* jobs() const { return &job_msg_; }
+    const partition_info_msg_t* partitions() const { return &part_msg_; }
+
+    // Free the job records once they have been extracted, as the job sources do
+    void release_jobs() {
+        std::vector<job_info_t>().swap(jobs_);
+        job_msg_.record_count = 0;
+        job_msg_.job_array = nullptr;
+    }
+
+private:
+    char* hostlist(unsigned first, unsigned last) {
+        char buf[64];
+        if (first == last) {
+            std::snprintf(buf, sizeof(buf), "n%05u", first);
+        } else {
+            std::snprintf(buf, sizeof(buf), "n[%05u-%05u]", first, last);
+        }
+        strings_.emplace_back(buf);
+        return &strings_.back()[0];
+    }
+
+    int32_t* node_inx(unsigned first, unsigned last) {
+        inx_.push_back(first);
+        inx_.push_back(last);
+        inx_.push_back(-1);
+        return &inx_[inx_.size() - 3];
+    }
+
+    std::vector<std::string> partition_names_, accounts_, names_;
+    std::deque<std::string> strings_;
+    std::vector<int32_t> inx_;
+    std::vector<job_info_t> jobs_;
+    std::vector<partition_info_t> parts_;
+    job_info_msg_t job_msg_;
+    partition_info_msg_t part_msg_;
+};
+
+
+class Stopwatch {
+public:
+    Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+    double lap() {
+        auto now = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(now - start_).count();
+        start_ = now;
+        return ns;
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+
+// Run the pipeline over one synthetic queue and print a row of results
+static void run(const Dataset& ds, unsigned count) {
+    SyntheticQueue queue(ds, count);
+    Options opts;
+    opts.orderby = {SORT_REMAINING};
+    JobBuckets buckets;
+
+    // Rendering goes to /dev/null so the terminal doesn't skew the numbers
+    std::fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+
+    Stopwatch sw;
+    JobTable jobs(queue.jobs());
+    queue.release_jobs();
+    double extract = sw.lap();
+    classify_jobs(opts, jobs, buckets);
+    compact_arrays(buckets);
+    double classify = sw.lap();
+    count_utilization(opts, queue.partitions(), buckets);
+    double utilization = sw.lap();
+    sort_jobs(opts, buckets);
+    double sort = sw.lap();
+    dup2(devnull, STDOUT_FILENO);
+    render_report(opts, buckets);
+    std::cout.flush();
+    std::fflush(stdout);
+    double render = sw.lap();
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    close(devnull);
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    size_t rows = buckets.running.size() + buckets.idle.size() + buckets.blocked.size();
+    std::printf("%-16s %8u %10.1f %10.1f %12.1f %10.1f %10.1f %10.1f %12.0f %10.1f\n",
+        ds.name, count, extract / count, classify / count, utilization / count, sort / count,
+        render / count, (extract + classify + utilization + sort + render) / count,
+        rows / (render / 1e9), usage.ru_maxrss / 1024.0);
+    std::fflush(stdout);
+}
+
+
+static const char USAGE[] = "Usage: showq_bench [jobs ...]\n"
+    "Benchmark the report pipeline with queues of each number of jobs (default: 1000 10000 "
+    "100000 1000000)\n";
+
+
+// A queue size: a whole number of jobs, at least one
+static bool parse_size(const char *arg, unsigned& size) {
+    if (!std::isdigit(static_cast<unsigned char>(*arg))) return false;
+    char *end;
+    errno = 0;
+    unsigned long value = std::strtoul(arg, &end, 10);
+    if (*end || errno || value == 0 || value > UINT32_MAX) return false;
+    size = value;
+    return true;
+}
+
+
+int main(int argc, char** argv) {
+    std::vector<unsigned> sizes;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help")) {
+            std::fputs(USAGE, stdout);
+            return 0;
+        }
+        unsigned size;
+        if (!parse_size(argv[i], size)) {
+            std::cerr << "Invalid number of jobs: " << argv[i] << "\n" << USAGE;
+            return 2;
+        }
+        sizes.push_back(size);
+    }
+    if (sizes.empty()) sizes = {1000, 10000, 100000, 1000000};
+
+    std::printf("%-16s %8s %10s %10s %12s %10s %10s %10s %12s %10s\n", "DATASET", "JOBS",
+        "EXTRACT", "CLASSIFY", "UTILIZATION", "SORT", "RENDER", "TOTAL", "RENDER", "RSS(MiB)");
+    std::printf("%-16s %8s %10s %10s %12s %10s %10s %10s %12s %10s\n", "", "", "ns/job", "ns/job",
+        "ns/job", "ns/job", "ns/job", "ns/job", "rows/s", "peak");
+    std::fflush(stdout);
+
+    // Each run gets its own process so peak RSS reflects that run alone
+    for (const Dataset& ds : DATASETS) {
+        for (unsigned count : sizes) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                run(ds, count);
+                std::_Exit(0);
+            }
+            int status = 0;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+                std::cerr << ds.name << " with " << count << " jobs failed" << std::endl;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,333 @@
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sys/socket.h"
+#include "sys/stat.h"
+#include "sys/un.h"
+#include "unistd.h"
+
+#include "daemon.hpp"
+#include "profile.hpp"
+#include "shared_table.hpp"
+
+
+// showqd serves the tables the reports use; none of them need the node table
+static const unsigned SERVED_TABLES = TABLE_JOBS | TABLE_PARTITIONS;
+
+// How long either end waits on a stalled peer before giving up on it
+static const int SOCKET_TIMEOUT = 10;
+
+// Clients answered at once; more wait to be accepted
+static const unsigned MAX_CLIENTS = 64;
+
+// How long to stop accepting after running out of file descriptors or memory
+static const useconds_t ACCEPT_BACKOFF = 100000;
+
+
+// Protocol: the client sends the generation of the tables it already has, or 0, and showqd
+// replies with its current generation followed, if they differ, by a snapshot of its tables.
+// The snapshot runs to the end of the connection. While showqd can't reach Slurm, once its
+// tables go stale it closes connections without replying.
+
+
+// A peer which has gone away is an error like any other, on either end, rather than SIGPIPE
+static bool write_all(int fd, const char *data, size_t size) {
+    while (size) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+
+static bool read_all(int fd, char *data, size_t size) {
+    while (size) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+
+static bool unix_address(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+
+static void set_timeouts(int fd) {
+    timeval timeout = {SOCKET_TIMEOUT, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+
+// Connect to a listening socket, returning -1 if nothing is listening there
+static int connect_to(const std::string& path) {
+    sockaddr_un addr;
+    if (!unix_address(path, addr)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+    set_timeouts(fd);
+    return fd;
+}
+
+
+// Listen on path, replacing a stale socket left by a showqd which has exited
+static int listen_on(const std::string& path) {
+    sockaddr_un addr;
+    if (!unix_address(path, addr)) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return -1;
+    }
+    int running = connect_to(path);
+    if (running >= 0) {
+        close(running);
+        std::cerr << "showqd is already running on " << path << std::endl;
+        return -1;
+    }
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))
+            || chmod(path.c_str(), 0666) || listen(fd, SOMAXCONN)) {
+        std::cerr << "Unable to listen on " << path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+// The latest snapshot, shared between the poller and the threads answering clients. Clients
+// keep a reference to the snapshot they are sent, so publishing a new one never waits on them.
+class SnapshotStore {
+public:
+    explicit SnapshotStore(unsigned interval) : interval_(interval) {}
+
+    void publish(std::vector<char>&& snapshot) {
+        std::shared_ptr<const std::vector<char>> fresh(new std::vector<char>(std::move(snapshot)));
+        std::lock_guard<std::mutex> lock(mutex_);
+        snapshot_ = fresh;
+        generation_++;
+        heartbeat_ = std::time(nullptr);
+    }
+
+    // Record that the latest snapshot is still current
+    void heartbeat() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        heartbeat_ = std::time(nullptr);
+    }
+
+    // The latest snapshot, or null once Slurm hasn't answered for long enough that it's stale
+    std::shared_ptr<const std::vector<char>> latest(uint64_t& generation) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (std::time(nullptr) - heartbeat_ > STALE_INTERVALS * interval_) return nullptr;
+        generation = generation_;
+        return snapshot_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::shared_ptr<const std::vector<char>> snapshot_;
+    unsigned interval_;
+    std::time_t heartbeat_ = 0;
+
+    // Starts from the clock so that a restarted showqd never repeats a generation a client has
+    uint64_t generation_ = std::chrono::system_clock::now().time_since_epoch().count();
+};
+
+
+// Counts the clients being answered, holding further connections in the listen queue while
+// MAX_CLIENTS are
+class ClientSlots {
+public:
+    void acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        free_.wait(lock, [this] { return active_ < MAX_CLIENTS; });
+        active_++;
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        active_--;
+        free_.notify_one();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable free_;
+    unsigned active_ = 0;
+};
+
+
+static void answer(int fd, const SnapshotStore& store, ClientSlots& slots) {
+    set_timeouts(fd);
+    uint64_t have = 0, generation = 0;
+    if (read_all(fd, reinterpret_cast<char *>(&have), sizeof(have))) {
+        // Leave clients to fall back to Slurm themselves rather than show them frozen tables
+        std::shared_ptr<const std::vector<char>> snapshot = store.latest(generation);
+        if (snapshot && write_all(fd, reinterpret_cast<const char *>(&generation), sizeof(generation))
+                && have != generation) {
+            write_all(fd, snapshot->data(), snapshot->size());
+        }
+    }
+    close(fd);
+    slots.release();
+}
+
+
+static void accept_clients(int listener, const SnapshotStore& store) {
+    ClientSlots slots;
+    for (;;) {
+        slots.acquire();
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            slots.release();
+            // Out of descriptors or memory: give answering clients a chance to finish
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                usleep(ACCEPT_BACKOFF);
+            }
+            continue;
+        }
+        std::thread(answer, fd, std::cref(store), std::ref(slots)).detach();
+    }
+}
+
+
+static std::vector<char> serialize(JobSource& source) {
+    ScopedTimer timer("serialize");
+    return serialize_snapshot(source.jobs(), source.partitions(), nullptr);
+}
+
+
+// Whether Slurm hides jobs from the users who didn't submit them. showqd answers anyone who
+// can reach it, so it would then show every client the jobs it can see: all of them if it runs
+// as root or SlurmUser. If slurmctld can't say, assume it does.
+static bool jobs_private() {
+    slurm_conf_t *conf = nullptr;
+    if (slurm_load_ctl_conf(0, &conf) != SLURM_SUCCESS || !conf) return true;
+    bool hidden = conf->private_data & PRIVATE_DATA_JOBS;
+    slurm_free_ctl_conf(conf);
+    return hidden;
+}
+
+
+bool serve_snapshots(const std::string& socket, const std::string& shm, unsigned interval,
+        bool allow_private, JobSource& source) {
+    if (!allow_private && jobs_private()) {
+        std::cerr << "Slurm's PrivateData hides jobs, or its config couldn't be read, and showqd "
+            "would show them to every client; pass --allow-private-data to serve them anyway"
+            << std::endl;
+        return false;
+    }
+    if (!source.load(SERVED_TABLES)) {
+        std::cerr << "Unable to query Slurm information" << std::endl;
+        return false;
+    }
+    SnapshotStore store(interval);
+    store.publish(serialize(source));
+    SharedTablePublisher publisher(shm, interval);
+    std::string error;
+    if (shm != "" && !publisher.prepare(error)) {
+        std::cerr << error << std::endl;
+        return false;
+    }
+    if (shm != "" && !publisher.publish(*source.jobs(), source.partitions())) {
+        std::cerr << "Unable to publish tables to " << shm << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (socket != "") {
+        int listener = listen_on(socket);
+        if (listener < 0) return false;
+        std::thread(accept_clients, listener, std::cref(store)).detach();
+    }
+
+    // Poll Slurm the same way --watch does, only republishing when something changed
+    for (;;) {
+        sleep(interval);
+        bool changed = false;
+        if (!source.refresh(SERVED_TABLES, changed)) {
+            std::cerr << "Unable to query Slurm information" << std::endl;
+            continue;
+        }
+        if (changed) {
+            store.publish(serialize(source));
+        } else {
+            store.heartbeat();
+        }
+        if (shm == "") continue;
+        if (!changed) {
+            publisher.heartbeat();
+        } else if (!publisher.publish(*source.jobs(), source.partitions())) {
+            std::cerr << "Unable to publish tables to " << shm << ": " << std::strerror(errno) << std::endl;
+        }
+    }
+}
+
+
+bool DaemonJobSource::read() {
+    bool changed;
+    return fetch(changed);
+}
+
+
+bool DaemonJobSource::refresh(unsigned tables, bool& changed) {
+    changed = false;
+    return fetch(changed) && load(tables);
+}
+
+
+bool DaemonJobSource::fetch(bool& changed) {
+    ScopedTimer timer("showqd");
+    int fd = connect_to(socket_);
+    if (fd < 0) return false;
+
+    uint64_t generation = 0;
+    std::vector<char> buffer;
+    bool ok = write_all(fd, reinterpret_cast<const char *>(&generation_), sizeof(generation_))
+        && read_all(fd, reinterpret_cast<char *>(&generation), sizeof(generation));
+    if (ok && generation != generation_) {
+        char chunk[65536];
+        ssize_t n;
+        while ((n = ::read(fd, chunk, sizeof(chunk))) > 0 || (n < 0 && errno == EINTR)) {
+            if (n > 0) buffer.insert(buffer.end(), chunk, chunk + n);
+        }
+        ok = n == 0;
+    }
+    close(fd);
+    if (!ok) return false;
+    if (generation == generation_) return true;
+
+    if (!parse(std::move(buffer))) {
+        std::cerr << "Unable to read snapshot from showqd on " << socket_ << std::endl;
+        return false;
+    }
+    generation_ = generation;
+    changed = true;
+    timer.records(jobs_ ? jobs_->size() : 0);
+    return true;
+}
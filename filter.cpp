@@ -0,0 +1,190 @@
+#include <cstring>
+#include <sstream>
+
+#include "fnmatch.h"
+
+#include "filter.hpp"
+
+
+bool Matcher::compile(const std::string& pattern, std::string& error) {
+    kind_ = MATCH_ANY;
+    pattern_ = pattern;
+    regex_.reset();
+    if (pattern.empty()) return true;
+
+    if (pattern[0] == '~') {
+        regex_t *regex = new regex_t;
+        int status = regcomp(regex, pattern.c_str() + 1, REG_EXTENDED | REG_NOSUB);
+        if (status) {
+            char message[256];
+            regerror(status, regex, message, sizeof(message));
+            delete regex;
+            error = "Invalid regex " + pattern.substr(1) + ": " + message;
+            return false;
+        }
+        kind_ = MATCH_REGEX;
+        regex_.reset(regex, [](regex_t *r) { regfree(r); delete r; });
+        return true;
+    }
+
+    size_t wildcard = pattern.find_first_of("*?[");
+    if (wildcard == std::string::npos) {
+        kind_ = MATCH_EXACT;
+    } else if (wildcard == pattern.size() - 1 && pattern[wildcard] == '*') {
+        kind_ = MATCH_PREFIX;
+        pattern_.pop_back();
+    } else {
+        kind_ = MATCH_GLOB;
+    }
+    return true;
+}
+
+
+bool Matcher::matches(const char *value) const {
+    return matches(value ? value : "", value ? std::strlen(value) : 0);
+}
+
+
+// Globs and regexes need their value NUL-terminated, so elements of a list are copied to the
+// stack first, unless they're unusually long
+bool Matcher::matches(const char *value, size_t len) const {
+    switch (kind_) {
+        case MATCH_ANY:
+            return true;
+        case MATCH_EXACT:
+            return len == pattern_.size() && std::memcmp(value, pattern_.data(), len) == 0;
+        case MATCH_PREFIX:
+            return len >= pattern_.size() && std::memcmp(value, pattern_.data(), pattern_.size()) == 0;
+        default:
+            break;
+    }
+    char buffer[256];
+    std::string copy;
+    if (value[len] != '\0') {
+        if (len < sizeof(buffer)) {
+            std::memcpy(buffer, value, len);
+            buffer[len] = '\0';
+            value = buffer;
+        } else {
+            copy.assign(value, len);
+            value = copy.c_str();
+        }
+    }
+    if (kind_ == MATCH_GLOB) return fnmatch(pattern_.c_str(), value, 0) == 0;
+    return regexec(regex_.get(), value, 0, nullptr, 0) == 0;
+}
+
+
+std::vector<std::string> split_list(const std::string& spec) {
+    std::vector<std::string> items;
+    std::istringstream list(spec);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+
+bool IdFilter::compile(const std::string& spec,
+        std::function<bool(const std::string&, uint32_t&)> resolve, std::string& unknown) {
+    include_.clear();
+    exclude_.clear();
+    for (const std::string& item : split_list(spec)) {
+        bool negated = item[0] == '!';
+        std::string name = negated ? item.substr(1) : item;
+        uint32_t id;
+        if (!resolve(name, id)) {
+            unknown = name;
+            return false;
+        }
+        (negated ? exclude_ : include_).insert(id);
+    }
+    return true;
+}
+
+
+bool IdFilter::single(uint32_t& id) const {
+    if (include_.size() != 1 || !exclude_.empty()) return false;
+    id = *include_.begin();
+    return true;
+}
+
+
+bool StringFilter::Key::operator==(const Key& other) const {
+    return len == other.len && std::memcmp(data, other.data, len) == 0;
+}
+
+
+// FNV-1a
+size_t StringFilter::KeyHash::operator()(const Key& key) const {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < key.len; i++) {
+        hash = (hash ^ static_cast<unsigned char>(key.data[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+
+bool StringFilter::Patterns::matches(const char *value, size_t len) const {
+    if (exact.count(Key{value, len})) return true;
+    for (const Matcher& matcher : matchers) {
+        if (matcher.matches(value, len)) return true;
+    }
+    return false;
+}
+
+
+bool StringFilter::compile(const std::string& spec, std::string& error) {
+    std::shared_ptr<Patterns> include, exclude;
+    for (const std::string& item : split_list(spec)) {
+        bool negated = item[0] == '!';
+        Matcher matcher;
+        if (!matcher.compile(negated ? item.substr(1) : item, error)) return false;
+        if (matcher.empty()) continue;
+        std::shared_ptr<Patterns>& patterns = negated ? exclude : include;
+        if (!patterns) patterns.reset(new Patterns());
+        if (matcher.exact()) {
+            patterns->values.push_back(matcher.pattern());
+        } else {
+            patterns->matchers.push_back(matcher);
+        }
+    }
+
+    // Only key the values once they've stopped moving
+    for (const std::shared_ptr<Patterns>& patterns : {include, exclude}) {
+        if (!patterns) continue;
+        for (const std::string& value : patterns->values) {
+            patterns->exact.insert(Key{value.data(), value.size()});
+        }
+    }
+    include_ = include;
+    exclude_ = exclude;
+    return true;
+}
+
+
+bool StringFilter::matches(const char *value, size_t len) const {
+    return (!include_ || include_->matches(value, len)) && !(exclude_ && exclude_->matches(value, len));
+}
+
+
+bool StringFilter::matches(const char *value) const {
+    if (empty()) return true;
+    return matches(value ? value : "", value ? std::strlen(value) : 0);
+}
+
+
+bool StringFilter::matches_any(const char *list) const {
+    if (empty()) return true;
+    if (!list || !std::strchr(list, ',')) return matches(list);
+    bool included = !include_;
+    for (const char *element = list; ; ) {
+        const char *comma = std::strchr(element, ',');
+        size_t len = comma ? comma - element : std::strlen(element);
+        if (exclude_ && exclude_->matches(element, len)) return false;
+        if (!included) included = include_->matches(element, len);
+        if (!comma) return included;
+        element = comma + 1;
+    }
+}
@@ -0,0 +1,116 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "format.hpp"
+
+
+static const char DAY_NAMES[7][4] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static const char MONTH_NAMES[12][4] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+
+static inline char* two_digits(char *p, unsigned value) {
+    p[0] = '0' + value / 10;
+    p[1] = '0' + value % 10;
+    return p + 2;
+}
+
+
+static char* unsigned_digits(char *p, unsigned long long value) {
+    char digits[20], *d = digits + sizeof(digits);
+    do {
+        *--d = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    size_t len = digits + sizeof(digits) - d;
+    std::memcpy(p, d, len);
+    return p + len;
+}
+
+
+size_t format_duration(char *buf, int seconds) {
+    char *p = buf;
+    long long secs = seconds;
+    if (secs < 0) {
+        secs = -secs;
+        *p++ = '-';
+    }
+
+    unsigned long long days = secs / 86400, hours = secs / 3600 % 24;
+    if (days > 0) {
+        p = unsigned_digits(p, days);
+        *p++ = ':';
+        p = two_digits(p, hours);
+    } else {
+        p = unsigned_digits(p, hours);
+    }
+    *p++ = ':';
+    p = two_digits(p, secs / 60 % 60);
+    *p++ = ':';
+    p = two_digits(p, secs % 60);
+    return p - buf;
+}
+
+
+// Write the "Www Mmm dd " part of a ctime() string
+static void format_date(char *p, const std::tm& tm) {
+    std::memcpy(p, DAY_NAMES[tm.tm_wday % 7], 3);
+    p[3] = ' ';
+    std::memcpy(p + 4, MONTH_NAMES[tm.tm_mon % 12], 3);
+    p[7] = ' ';
+    p[8] = tm.tm_mday >= 10 ? '0' + tm.tm_mday / 10 : ' ';
+    p[9] = '0' + tm.tm_mday % 10;
+    p[10] = ' ';
+}
+
+
+// Cache the day containing t, unless the UTC offset changes during it
+bool TimestampFormatter::cache_day(std::time_t t) {
+    std::tm tm, first, last;
+    if (!localtime_r(&t, &tm)) return false;
+    std::time_t start = t - (tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec);
+    std::time_t end = start + 86400;
+    std::time_t last_second = end - 1;
+    if (!localtime_r(&start, &first) || first.tm_mday != tm.tm_mday || first.tm_hour != 0
+            || first.tm_min != 0 || first.tm_sec != 0) {
+        return false;
+    }
+    if (!localtime_r(&last_second, &last) || last.tm_mday != tm.tm_mday
+            || last.tm_hour != 23 || last.tm_min != 59 || last.tm_sec != 59) {
+        return false;
+    }
+    day_start_ = start;
+    day_end_ = end;
+    format_date(prefix_, tm);
+    return true;
+}
+
+
+size_t TimestampFormatter::format(char *buf, std::time_t t) {
+    if (t < day_start_ || t >= day_end_ || day_start_ == day_end_) {
+        if (!cache_day(t)) {
+            std::tm tm;
+            if (!localtime_r(&t, &tm)) {
+                std::memset(buf, '?', TIMESTAMP_LEN);
+                return TIMESTAMP_LEN;
+            }
+            format_date(buf, tm);
+            char *p = two_digits(buf + 11, tm.tm_hour);
+            *p++ = ':';
+            p = two_digits(p, tm.tm_min);
+            *p++ = ':';
+            two_digits(p, tm.tm_sec);
+            return TIMESTAMP_LEN;
+        }
+    }
+
+    unsigned secs = t - day_start_;
+    std::memcpy(buf, prefix_, sizeof(prefix_));
+    char *p = two_digits(buf + 11, secs / 3600);
+    *p++ = ':';
+    p = two_digits(p, secs / 60 % 60);
+    *p++ = ':';
+    two_digits(p, secs % 60);
+    return TIMESTAMP_LEN;
+}
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+
+#include "grp.h"
+#include "pwd.h"
+#include "unistd.h"
+
+#include "identity.hpp"
+
+
+template <typename T>
+static bool parse_id(const std::string& str, T& id) {
+    if (str.empty() || str.size() > 10) return false;
+    if (!std::all_of(str.begin(), str.end(), [](char c){ return std::isdigit(c); })) return false;
+    unsigned long value = std::stoul(str);
+    id = static_cast<T>(value);
+    return value == static_cast<unsigned long>(id);
+}
+
+
+static size_t initial_buffer_size() {
+    long pw_max = sysconf(_SC_GETPW_R_SIZE_MAX), gr_max = sysconf(_SC_GETGR_R_SIZE_MAX);
+    return static_cast<size_t>(std::max(1024L, std::max(pw_max, gr_max)));
+}
+
+
+IdentityCache::IdentityCache() : buffer_(initial_buffer_size()) {}
+
+
+const std::string& IdentityCache::user(uid_t uid) {
+    auto it = users_.find(uid);
+    if (it != users_.end()) return it->second;
+
+    passwd pw, *result = nullptr;
+    lookups_++;
+    while (getpwuid_r(uid, &pw, buffer_.data(), buffer_.size(), &result) == ERANGE) {
+        buffer_.resize(buffer_.size() * 2);
+    }
+    return users_.emplace(uid, result ? pw.pw_name : std::to_string(uid)).first->second;
+}
+
+
+const std::string& IdentityCache::group(gid_t gid) {
+    auto it = groups_.find(gid);
+    if (it != groups_.end()) return it->second;
+
+    struct group gr, *result = nullptr;
+    lookups_++;
+    while (getgrgid_r(gid, &gr, buffer_.data(), buffer_.size(), &result) == ERANGE) {
+        buffer_.resize(buffer_.size() * 2);
+    }
+    return groups_.emplace(gid, result ? gr.gr_name : std::to_string(gid)).first->second;
+}
+
+
+bool IdentityCache::user_id(const std::string& name, uid_t& uid) {
+    passwd pw, *result = nullptr;
+    lookups_++;
+    while (getpwnam_r(name.c_str(), &pw, buffer_.data(), buffer_.size(), &result) == ERANGE) {
+        buffer_.resize(buffer_.size() * 2);
+    }
+    if (result) {
+        uid = pw.pw_uid;
+        users_.emplace(uid, pw.pw_name);
+        return true;
+    }
+    return parse_id(name, uid);
+}
+
+
+bool IdentityCache::group_id(const std::string& name, gid_t& gid) {
+    struct group gr, *result = nullptr;
+    lookups_++;
+    while (getgrnam_r(name.c_str(), &gr, buffer_.data(), buffer_.size(), &result) == ERANGE) {
+        buffer_.resize(buffer_.size() * 2);
+    }
+    if (result) {
+        gid = gr.gr_gid;
+        groups_.emplace(gid, gr.gr_name);
+        return true;
+    }
+    return parse_id(name, gid);
+}
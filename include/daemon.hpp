@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "job_source.hpp"
+
+
+// Where showqd listens, and where showq looks for it, unless --socket says otherwise
+const char *const SHOWQD_SOCKET = "/run/showqd.sock";
+
+
+// Run as showqd: load the job and partition tables, then serve snapshots of them to showq
+// clients on a Unix socket and publish them to a shared memory file, unless either path is
+// empty, while refreshing them from Slurm every interval seconds. However many users run
+// showq, slurmctld only sees this one poller. Since every client sees whatever showqd can,
+// refuses to start when Slurm's PrivateData hides jobs unless allow_private is set. Only
+// returns if it can't start.
+bool serve_snapshots(const std::string& socket, const std::string& shm, unsigned interval,
+    bool allow_private, JobSource& source);
+
+
+// Loads tables from a running showqd. Refreshes only transfer the tables again if showqd has
+// fetched new ones since.
+class DaemonJobSource : public SnapshotJobSource {
+public:
+    explicit DaemonJobSource(const std::string& socket) : socket_(socket) {}
+
+    bool refresh(unsigned tables, bool& changed) override;
+
+protected:
+    bool read() override;
+
+private:
+    bool fetch(bool& changed);
+
+    std::string socket_;
+    uint64_t generation_ = 0;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "regex.h"
+
+
+// A filter value compiled once into the cheapest way of matching it: "~regex" as an extended
+// regular expression, a value ending in its only * as a prefix, any other value with *, ?, or
+// [ as a shell glob, and anything else exactly. Values are matched as C strings, without
+// copying them, with null matching like the empty string.
+class Matcher {
+public:
+    // On failure sets error and returns false
+    bool compile(const std::string& pattern, std::string& error);
+
+    // Whether there is no pattern, so that everything matches
+    bool empty() const { return kind_ == MATCH_ANY; }
+
+    bool matches(const char *value) const;
+    bool matches(const char *value, size_t len) const;
+
+    // Whether the pattern is a plain value, matched exactly
+    bool exact() const { return kind_ == MATCH_EXACT; }
+    const std::string& pattern() const { return pattern_; }
+
+private:
+    enum Kind { MATCH_ANY, MATCH_EXACT, MATCH_PREFIX, MATCH_GLOB, MATCH_REGEX };
+
+    Kind kind_ = MATCH_ANY;
+    std::string pattern_;
+    std::shared_ptr<regex_t> regex_;
+};
+
+
+// Split a comma-separated list, skipping empty items
+std::vector<std::string> split_list(const std::string& spec);
+
+
+// A filter on user or group IDs from a comma-separated list, where IDs prefixed with ! are
+// excluded. Jobs pass if they have one of the listed IDs, or any ID when only exclusions are
+// listed. Each test is a hash lookup however long the list is.
+class IdFilter {
+public:
+    // Resolves each item to an ID. On failure sets unknown to the item and returns false.
+    bool compile(const std::string& spec, std::function<bool(const std::string&, uint32_t&)> resolve,
+        std::string& unknown);
+
+    bool empty() const { return include_.empty() && exclude_.empty(); }
+
+    bool matches(uint32_t id) const {
+        return (include_.empty() || include_.count(id)) && !exclude_.count(id);
+    }
+
+    // The only ID passing the filter, if it is a single ID
+    bool single(uint32_t& id) const;
+
+private:
+    std::unordered_set<uint32_t> include_, exclude_;
+};
+
+
+// A filter on a string field from a comma-separated list of Matcher patterns, where patterns
+// prefixed with ! are excluded. Plain values are kept in a hash set, so lists of them cost
+// one lookup per value tested; only globs and regexes are tried one by one.
+class StringFilter {
+public:
+    // On failure sets error and returns false
+    bool compile(const std::string& spec, std::string& error);
+
+    bool empty() const { return !include_ && !exclude_; }
+
+    bool matches(const char *value) const;
+
+    // Whether a comma-separated list passes, as with jobs submitted to several partitions: any
+    // element must be included and none excluded
+    bool matches_any(const char *list) const;
+
+private:
+    // A value to look up without copying it
+    struct Key {
+        const char *data;
+        size_t len;
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Patterns {
+        std::vector<std::string> values;  // Owns the strings exact points into
+        std::unordered_set<Key, KeyHash> exact;
+        std::vector<Matcher> matchers;
+
+        bool matches(const char *value, size_t len) const;
+    };
+
+    bool matches(const char *value, size_t len) const;
+
+    // Shared so that copies of the filter keep their keys pointing into live strings
+    std::shared_ptr<const Patterns> include_, exclude_;
+};
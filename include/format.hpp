@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+
+
+// Longest output of format_duration(), e.g. "-24855:03:14:08"
+const size_t DURATION_MAX = 16;
+
+// Length of a formatted timestamp, e.g. "Tue Nov 14 22:13:20"
+const size_t TIMESTAMP_LEN = 19;
+
+
+// Write a duration as [-][D:HH]:MM:SS (or H:MM:SS under a day) into buf, which must hold
+// DURATION_MAX characters. Returns the length written; no terminator is added.
+size_t format_duration(char *buf, int seconds);
+
+
+// Formats timestamps like ctime() without the year, remembering the date of the last day
+// it saw so that runs of timestamps on the same day only need their time of day formatted
+class TimestampFormatter {
+public:
+    // Write t into buf, which must hold TIMESTAMP_LEN characters. No terminator is added.
+    size_t format(char *buf, std::time_t t);
+
+private:
+    bool cache_day(std::time_t t);
+
+    // Timestamps in [day_start_, day_end_) share the cached "Www Mmm dd " prefix
+    std::time_t day_start_ = 0, day_end_ = 0;
+    char prefix_[11];
+};
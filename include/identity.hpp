@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sys/types.h"
+
+
+// Resolves user and group IDs to names, hitting NSS at most once per distinct ID.
+// Lookups against LDAP/SSSD backends are far more expensive than everything
+// else showq does per job, so every name rendered goes through this cache.
+class IdentityCache {
+public:
+    const std::string& user(uid_t uid);
+    const std::string& group(gid_t gid);
+
+    // Resolve a user name (or a numeric UID) to a UID, seeding the cache on success
+    bool user_id(const std::string& name, uid_t& uid);
+
+    // Resolve a group name (or a numeric GID) to a GID, seeding the cache on success
+    bool group_id(const std::string& name, gid_t& gid);
+
+    unsigned long lookups() const { return lookups_; }
+    size_t users() const { return users_.size(); }
+    size_t groups() const { return groups_.size(); }
+
+    static IdentityCache& instance() {
+        static IdentityCache cache;
+        return cache;
+    }
+
+private:
+    IdentityCache();
+
+    std::unordered_map<uid_t, std::string> users_;
+    std::unordered_map<gid_t, std::string> groups_;
+    std::vector<char> buffer_;
+    unsigned long lookups_ = 0;
+};
+
+
+inline const std::string& uid2name(unsigned int uid) {
+    return IdentityCache::instance().user(uid);
+}
+
+
+inline const std::string& gid2name(unsigned int gid) {
+    return IdentityCache::instance().group(gid);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sys/types.h"
+
+#include "slurm/slurm.h"
+
+#include "job_table.hpp"
+
+
+// The Slurm tables a report can depend on
+enum SlurmTable : unsigned {
+    TABLE_JOBS = 1 << 0,
+    TABLE_PARTITIONS = 1 << 1,
+    TABLE_NODES = 1 << 2,
+    TABLE_ALL = TABLE_JOBS | TABLE_PARTITIONS | TABLE_NODES,
+
+    // Slurm's own job records, for reports which only count jobs and so needn't extract them
+    TABLE_JOB_RECORDS = 1 << 3,
+};
+
+
+// Where showq gets its job, partition, and node tables from. Tables are loaded on demand,
+// so a report only pays for the ones it needs. Jobs are extracted into a JobTable as they are
+// loaded, and Slurm's much larger job records aren't kept.
+class JobSource {
+public:
+    virtual ~JobSource() {}
+
+    // Load any of the requested tables which haven't been loaded yet
+    virtual bool load(unsigned tables) = 0;
+
+    // Reload the requested tables if they have changed. Sets changed if any table was replaced.
+    virtual bool refresh(unsigned tables, bool& changed) = 0;
+
+    const JobTable* jobs() { return load(TABLE_JOBS) ? jobs_.get() : nullptr; }
+
+    // The job records as Slurm sent them, or null if the source doesn't keep them or has
+    // already extracted them into a JobTable
+    const job_info_msg_t* job_records() { return load(TABLE_JOB_RECORDS) ? job_records_ : nullptr; }
+
+    partition_info_msg_t* partitions() { return load(TABLE_PARTITIONS) ? partitions_ : nullptr; }
+    node_info_msg_t* nodes() { return load(TABLE_NODES) ? nodes_ : nullptr; }
+
+protected:
+    std::unique_ptr<JobTable> jobs_;
+    job_info_msg_t *job_records_ = nullptr;
+    partition_info_msg_t *partitions_ = nullptr;
+    node_info_msg_t *nodes_ = nullptr;
+};
+
+
+// Loads tables from slurmctld through libslurm
+class SlurmJobSource : public JobSource {
+public:
+    // With user_only set, the controller only sends the jobs belonging to uid
+    explicit SlurmJobSource(bool user_only = false, uid_t uid = 0);
+    ~SlurmJobSource();
+
+    SlurmJobSource(const SlurmJobSource&) = delete;
+    SlurmJobSource& operator=(const SlurmJobSource&) = delete;
+
+    bool load(unsigned tables) override;
+
+    // Passes Slurm the time of the current snapshot so that unchanged tables aren't resent
+    bool refresh(unsigned tables, bool& changed) override;
+
+private:
+    bool user_only_;
+    uid_t uid_;
+};
+
+
+// Loads tables from a snapshot written by write_snapshot(), for reproducing and
+// benchmarking production-sized queues without a controller
+class SnapshotJobSource : public JobSource {
+public:
+    explicit SnapshotJobSource(const std::string& path);
+
+    SnapshotJobSource(const SnapshotJobSource&) = delete;
+    SnapshotJobSource& operator=(const SnapshotJobSource&) = delete;
+
+    bool load(unsigned tables) override;
+
+    // Rereads the snapshot if the file has been modified since it was loaded
+    bool refresh(unsigned tables, bool& changed) override;
+
+    // Parse a snapshot from memory, taking ownership of the buffer
+    bool parse(std::vector<char>&& buffer);
+
+protected:
+    SnapshotJobSource() : SnapshotJobSource(std::string()) {}
+
+    // Load the snapshot, wherever it comes from
+    virtual bool read();
+
+private:
+    std::string path_;
+    std::time_t mtime_ = 0;
+    bool loaded_ = false;
+
+    // The partition and node tables point into buffer_ for their strings and node indexes
+    std::vector<char> buffer_;
+    std::vector<partition_info_t> partition_array_;
+    std::vector<node_info_t> node_array_;
+    partition_info_msg_t partition_msg_;
+    node_info_msg_t node_msg_;
+};
+
+
+// Serialize the given tables into a snapshot. The format uses native byte order and is only
+// meant to be read back by showq on the same kind of machine.
+std::vector<char> serialize_snapshot(const JobTable *jobs,
+    const partition_info_msg_t *partitions, const node_info_msg_t *nodes);
+
+// Serialize all of a source's tables to a snapshot file
+bool write_snapshot(const std::string& path, JobSource& source);
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <initializer_list>
+#include <vector>
+
+#include "slurm/slurm.h"
+
+
+// An array which either owns its values or views values kept elsewhere, such as in a mapped
+// snapshot which must outlive it. Only owned columns can be changed.
+template <typename T>
+class Array {
+public:
+    Array() {}
+    Array(size_t n, T value) : owned_(n, value) { sync(); }
+
+    Array(const Array&) = delete;
+    Array& operator=(const Array&) = delete;
+    Array(Array&&) = default;
+    Array& operator=(Array&&) = default;
+
+    const T& operator[](size_t i) const { return data_[i]; }
+    const T* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    void reserve(size_t n) { owned_.reserve(n); sync(); }
+    void push_back(T value) { owned_.push_back(value); sync(); }
+    void append(const T *values, size_t n) { owned_.insert(owned_.end(), values, values + n); sync(); }
+    void assign(size_t n, T value) { owned_.assign(n, value); sync(); }
+    void set(size_t i, T value) { owned_[i] = value; }
+
+    // Drop any owned values and view n values at data instead
+    void view(const T *data, size_t n) {
+        std::vector<T>().swap(owned_);
+        data_ = data;
+        size_ = n;
+    }
+
+private:
+    void sync() {
+        data_ = owned_.data();
+        size_ = owned_.size();
+    }
+
+    std::vector<T> owned_;
+    const T *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+
+// A set of strings, each stored once in a shared heap and referred to by a dense index.
+// Index 0 is always the null string.
+class StringPool {
+public:
+    typedef uint32_t Id;
+    static const Id NULL_ID = 0;
+
+    StringPool();
+
+    // The index of s, adding it if it hasn't been seen before
+    Id intern(const char *s);
+
+    const char* get(Id id) const { return id == NULL_ID ? nullptr : &heap_[offsets_[id]]; }
+    uint32_t size() const { return offsets_.size(); }
+
+    // Whether every index and offset stays inside the pool, as when viewing untrusted arrays
+    bool valid() const;
+
+    // Call visit on each of the pool's arrays, in a fixed order
+    template <typename Visitor>
+    void visit(Visitor& visit) { visit(heap_); visit(offsets_); visit(hashes_); visit(slots_); }
+    template <typename Visitor>
+    void visit(Visitor& visit) const { visit(heap_); visit(offsets_); visit(hashes_); visit(slots_); }
+
+private:
+    void grow();
+
+    Array<char> heap_;
+    Array<uint32_t> offsets_, hashes_;
+
+    // Open-addressed hash table of string indexes, with 0 marking empty slots
+    Array<Id> slots_;
+};
+
+
+// A column of strings, most of which repeat from job to job
+class StringColumn {
+public:
+    void reserve(size_t n) { ids_.reserve(n); }
+    void push_back(const char *s) { ids_.push_back(pool_.intern(s)); }
+
+    const char* operator[](uint32_t row) const { return pool_.get(ids_[row]); }
+    StringPool::Id id(uint32_t row) const { return ids_[row]; }
+    const StringPool& pool() const { return pool_; }
+    bool valid(uint32_t rows) const;
+
+    template <typename Visitor>
+    void visit(Visitor& visit) { visit(ids_); pool_.visit(visit); }
+    template <typename Visitor>
+    void visit(Visitor& visit) const { visit(ids_); pool_.visit(visit); }
+
+private:
+    Array<StringPool::Id> ids_;
+    StringPool pool_;
+};
+
+
+// The fields of Slurm's job table which showq uses, extracted into one array per field so that
+// filtering and sorting touch only the fields they need
+struct JobTable {
+    JobTable() {}
+    explicit JobTable(const job_info_msg_t *jobs);
+
+    // Add a job to the end of the table
+    void append(const job_info_t& job);
+    void reserve(size_t n);
+
+    uint32_t size() const { return job_id.size(); }
+
+    // Whether every column has a value for each job and every index stays inside its array
+    bool valid() const;
+
+    // The job's node indexes in Slurm's node_inx form, or nullptr if it has none
+    const int32_t* node_inx(uint32_t row) const {
+        return node_inx_start[row] == NO_NODE_INX ? nullptr : &node_inx_data[node_inx_start[row]];
+    }
+
+    // Call visit on each of the table's arrays, string pools included, in a fixed order
+    template <typename Visitor>
+    void visit(Visitor& visit) { visit_columns(*this, visit); }
+    template <typename Visitor>
+    void visit(Visitor& visit) const { visit_columns(*this, visit); }
+
+    std::time_t last_update = 0;
+    Array<uint32_t> job_id, array_job_id, array_task_id, user_id, group_id, job_state,
+        state_reason, exit_code, priority, time_limit, num_tasks, num_cpus, num_nodes;
+    Array<std::time_t> submit_time, eligible_time, start_time, end_time;
+    StringColumn name, account, partition, qos, resv_name, batch_host, nodes, array_task_str;
+
+    // Each job's -1 terminated node index ranges, stored back to back
+    static const uint32_t NO_NODE_INX = 0xffffffff;
+    Array<uint32_t> node_inx_start;
+    Array<int32_t> node_inx_data;
+
+private:
+    template <typename Table, typename Visitor>
+    static void visit_columns(Table& t, Visitor& visit) {
+        for (auto column : {&t.job_id, &t.array_job_id, &t.array_task_id, &t.user_id, &t.group_id,
+                &t.job_state, &t.state_reason, &t.exit_code, &t.priority, &t.time_limit,
+                &t.num_tasks, &t.num_cpus, &t.num_nodes, &t.node_inx_start}) {
+            visit(*column);
+        }
+        for (auto column : {&t.submit_time, &t.eligible_time, &t.start_time, &t.end_time}) {
+            visit(*column);
+        }
+        for (auto column : {&t.name, &t.account, &t.partition, &t.qos, &t.resv_name, &t.batch_host,
+                &t.nodes, &t.array_task_str}) {
+            column->visit(visit);
+        }
+        visit(t.node_inx_data);
+    }
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "format.hpp"
+#include "job_table.hpp"
+#include "output.hpp"
+
+
+// The name showq gives a Slurm job state
+const char* state2cstr(unsigned int state);
+
+
+// The tasks of a job array which are listed in a single row
+struct ArrayTasks {
+    std::string tasks;  // In Slurm's task range syntax, like "1-5,9%2"
+    unsigned long count = 0;
+};
+
+// The rows standing for whole job arrays, and the tasks each stands for
+typedef std::unordered_map<uint32_t, ArrayTasks> ArrayRows;
+
+
+// What columns need to know to render a job's row
+struct RowContext {
+    RowContext(const JobTable& jobs, bool jobname) : jobs(jobs), jobname(jobname) {}
+
+    // The tasks a row stands for, or null if it is a single job
+    const ArrayTasks* array(uint32_t row) const {
+        if (!arrays || arrays->empty()) return nullptr;
+        auto found = arrays->find(row);
+        return found == arrays->end() ? nullptr : &found->second;
+    }
+
+    const JobTable& jobs;
+    bool jobname;  // Show job names in the jobid column
+    const ArrayRows *arrays = nullptr;
+    std::time_t now = std::time(nullptr);
+    TimestampFormatter timestamps;
+};
+
+
+// A compiled --format spec: a list of columns, each with the text before it, the function that
+// appends its field, and its width and alignment. Specs look like "%-18jobid %8user{OWNER}",
+// where each column is %[-][width][.max]field[{title}]: - aligns left, width pads with spaces,
+// max truncates text fields, and the title replaces the field's header. %% is a literal %.
+class Layout {
+public:
+    Layout() {}
+
+    // Compile a spec, replacing any previous one. On failure sets error and returns false.
+    bool compile(const std::string& spec, std::string& error);
+
+    // Append the header line and a job's row, without newlines
+    void header(OutputBuffer& out) const;
+    void row(OutputBuffer& out, RowContext& ctx, uint32_t row) const;
+
+    // The names of the fields a spec can use, separated by spaces
+    static std::string field_names();
+
+    struct Column;
+    typedef void (*Append)(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row);
+
+    struct Column {
+        std::string prefix, title;
+        Append append;
+        size_t width, max;
+        bool left;
+    };
+
+private:
+    std::vector<Column> columns_;
+    std::string suffix_;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+
+#include "unistd.h"
+
+
+// Accumulates report output in one contiguous buffer and writes it out with a few large
+// write() calls, instead of a printf or iostream call per field
+class OutputBuffer {
+public:
+    // Output is written to fd once more than flush_at bytes are buffered, and on flush()
+    explicit OutputBuffer(int fd = STDOUT_FILENO, size_t flush_at = 1 << 20);
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    OutputBuffer& chr(char c) {
+        buf_.push_back(c);
+        return *this;
+    }
+
+    OutputBuffer& str(const char *s, size_t len) {
+        buf_.append(s, len);
+        if (buf_.size() > flush_at_) flush();
+        return *this;
+    }
+
+    OutputBuffer& str(const char *s) { return str(s, std::strlen(s)); }
+    OutputBuffer& str(const std::string& s) { return str(s.data(), s.size()); }
+    OutputBuffer& num(unsigned long value);
+    OutputBuffer& signed_num(long value);
+
+    // Append at most max characters of s, padded with spaces to width, like %-W.Ms and %W.Ms
+    OutputBuffer& left(const char *s, size_t width, size_t max = std::string::npos);
+    OutputBuffer& right(const char *s, size_t width, size_t max = std::string::npos);
+    OutputBuffer& left(const std::string& s, size_t width, size_t max = std::string::npos) {
+        return left(s.c_str(), width, max);
+    }
+    OutputBuffer& right(const std::string& s, size_t width, size_t max = std::string::npos) {
+        return right(s.c_str(), width, max);
+    }
+
+    // Append an unsigned integer padded with spaces to width, like %-Wu and %Wu
+    OutputBuffer& left(unsigned long value, size_t width);
+    OutputBuffer& right(unsigned long value, size_t width);
+
+    // Append a number with one decimal place, padded with spaces to width, like %W.1f
+    OutputBuffer& fixed1(double value, size_t width, bool left = false);
+
+    // Append len characters of s, padded with spaces to width on the right if left is set
+    OutputBuffer& pad(const char *s, size_t len, size_t width, bool left);
+
+    // Write out everything buffered so far
+    bool flush();
+
+    size_t size() const { return buf_.size(); }
+
+private:
+    int fd_;
+    size_t flush_at_;
+    std::string buf_;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// Accumulates wall time, records handled, and NSS lookups for each phase of a run
+class Profiler {
+public:
+    struct Phase {
+        std::string name;
+        unsigned long calls = 0;
+        double ns = 0;
+        unsigned long records = 0;
+        unsigned long lookups = 0;
+    };
+
+    bool enabled() const { return enabled_; }
+    void enable() { enabled_ = true; }
+
+    void add(const char *name, double ns, unsigned long records, unsigned long lookups);
+
+    void print_text(std::ostream& os) const;
+    void print_json(std::ostream& os) const;
+
+    static Profiler& instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+private:
+    bool enabled_ = false;
+    std::vector<Phase> phases_;
+};
+
+
+// Times the enclosing scope as a phase of the run. Does nothing unless profiling is enabled.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char *phase);
+    ~ScopedTimer();
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    // The number of records the phase handled
+    void records(unsigned long count) { records_ = count; }
+
+private:
+    const char *phase_;
+    bool enabled_;
+    unsigned long records_ = 0;
+    unsigned long lookups_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Where sites set which reasons block pending jobs, unless --config says otherwise
+const char *const SHOWQ_CONFIG = "/etc/slurm/showq.conf";
+
+
+// A set of Slurm job state reasons, kept as a table indexed by reason so that testing a job
+// costs one load
+class ReasonSet {
+public:
+    bool contains(uint32_t reason) const {
+        return reason < reasons_.size() && reasons_[reason];
+    }
+    bool empty() const { return count_ == 0; }
+
+    void add(uint32_t reason);
+    void remove(uint32_t reason);
+    void clear();
+
+private:
+    std::vector<uint8_t> reasons_;
+    size_t count_ = 0;
+};
+
+
+// The reasons which block pending jobs unless the site or --blocked-reasons says otherwise
+ReasonSet default_blocked_reasons();
+
+// Apply a comma-separated list of reasons, named as squeue prints them (ignoring case) or
+// numbered, to a set. Plain reasons replace the set's contents; reasons prefixed with + or -
+// are added to or removed from it. On failure sets error and returns false, leaving the set
+// as it was.
+bool parse_reasons(const std::string& spec, ReasonSet& reasons, std::string& error);
+
+// Read a site config file of "key = value" lines, with # starting comments. Its
+// blocked_reasons setting is applied to blocked as by parse_reasons. A missing file is not an
+// error.
+bool load_config(const std::string& path, ReasonSet& blocked, std::string& error);
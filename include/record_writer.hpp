@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "job_table.hpp"
+#include "output.hpp"
+
+
+// How reports are printed: as the fixed-width text showq has always printed, or as records
+// for scripts
+enum OutputFormat {
+    OUTPUT_TEXT,
+    OUTPUT_JSON,
+    OUTPUT_CSV,
+    OUTPUT_NDJSON,
+};
+
+
+// Streams records with a fixed list of fields straight into an OutputBuffer, as a JSON array
+// of objects, one JSON object per line, or CSV with a header line. Each record's values are
+// given in field order. Strings are only escaped or quoted when they need it.
+class RecordWriter {
+public:
+    RecordWriter(OutputBuffer& out, OutputFormat format, const std::vector<const char *>& fields);
+
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    void begin_record();
+    void end_record();
+
+    RecordWriter& value(unsigned long n);
+    RecordWriter& signed_value(long n);
+    RecordWriter& value(const char *s);  // Null strings are written as null, or empty in CSV
+
+    // Slurm's NO_VAL and INFINITE are written as null too, rather than as huge numbers
+    RecordWriter& slurm_value(uint32_t n);
+
+    // A real number, with one decimal place as the text reports print it
+    RecordWriter& fixed_value(double n);
+
+    // Close the JSON array
+    void finish();
+
+private:
+    void next_field();
+    void json_string(const char *s);
+    void csv_string(const char *s);
+
+    OutputBuffer& out_;
+    OutputFormat format_;
+    std::vector<std::string> keys_;  // Each field's separator and JSON key
+    size_t field_ = 0;
+    unsigned long records_ = 0;
+};
+
+
+struct ArrayTasks;
+
+
+// The fields written for each job: the section it is in followed by the job table's fields,
+// untruncated, with times in seconds since the epoch and time limits in minutes as Slurm
+// gives them, and numbers Slurm left unset or unlimited as null
+const std::vector<const char *>& job_record_fields();
+
+// Write a job's record. A row standing for a whole job array also gets its task ranges and
+// the number of tasks.
+void write_job(RecordWriter& writer, const char *section, const JobTable& jobs, uint32_t row,
+    const ArrayTasks *array = nullptr);
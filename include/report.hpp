@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "slurm/slurm.h"
+
+#include "filter.hpp"
+#include "job_source.hpp"
+#include "job_table.hpp"
+#include "layout.hpp"
+#include "reasons.hpp"
+#include "record_writer.hpp"
+#include "sort.hpp"
+
+
+// The reports showq can print, in order of precedence when several are requested
+enum Report {
+    REPORT_GROUPED,
+    REPORT_SUMMARY,
+    REPORT_COMPLETED,
+    REPORT_RUNNING,
+    REPORT_IDLE,
+    REPORT_BLOCKED,
+    REPORT_DEFAULT,
+};
+
+
+// What the grouped report totals jobs by
+enum GroupKey {
+    GROUP_USER,
+    GROUP_GROUP,
+    GROUP_ACCOUNT,
+    GROUP_PARTITION,
+    GROUP_QOS,
+};
+
+
+// The totals the grouped report can be ordered by. Totals sort largest first and keys
+// alphabetically.
+enum AggregateKey {
+    AGGREGATE_KEY,
+    AGGREGATE_JOBS,
+    AGGREGATE_ACTIVE,
+    AGGREGATE_ELIGIBLE,
+    AGGREGATE_BLOCKED,
+    AGGREGATE_CORES,
+    AGGREGATE_NODES,
+    AGGREGATE_COREHOURS,
+};
+
+
+// Parse a group key name like "user", ignoring case. On failure sets error and returns false.
+bool parse_group_key(const std::string& name, GroupKey& key, std::string& error);
+
+// Parse a comma-separated list of total names like "CORES,JOBS", ignoring case. On failure
+// sets error and returns false.
+bool parse_aggregate_keys(const std::string& spec, std::vector<AggregateKey>& keys,
+    std::string& error);
+
+// The names of the group keys and of the totals, separated by commas
+std::string group_key_names();
+std::string aggregate_key_names();
+
+
+// The Slurm tables needed to print a report
+unsigned report_tables(Report report);
+
+
+// Everything controlling which jobs are shown and how
+struct Options {
+    Report report = REPORT_DEFAULT;
+    bool jobname = false, nodes = false;
+    IdFilter users, groups;
+    StringFilter account, qos, partition, reservation;
+    ReasonSet blocked_reasons = default_blocked_reasons();  // Pending reasons which block jobs
+    ReasonSet reasons;  // Reasons to show jobs for, or empty for all of them
+    std::vector<SortKey> orderby;
+    GroupKey by = GROUP_USER;  // What the grouped report totals jobs by
+    std::vector<AggregateKey> by_order;  // How the grouped report's rows are ordered
+    std::string format;  // A Layout spec replacing every section's columns
+    OutputFormat output = OUTPUT_TEXT;
+    unsigned threads = 0;  // Threads to classify jobs with, or 0 for one per core
+    size_t limit = 0;  // Jobs to show in each section, or 0 for all of them
+    bool expand_arrays = false;  // List each array task on its own line
+};
+
+
+// The jobs which passed the filters, split into the report's sections
+struct JobBuckets {
+    const JobTable *table = nullptr;
+    std::vector<uint32_t> running, idle, blocked, complete;  // Rows of table
+    size_t running_jobs = 0, idle_jobs = 0, blocked_jobs = 0, complete_jobs = 0;  // Before compaction
+    int running_nodes = 0, partition_nodes = 0;
+    ArrayRows arrays;  // The rows listing whole job arrays
+};
+
+
+// The sections jobs are sorted into
+enum Category {
+    CATEGORY_RUNNING,
+    CATEGORY_IDLE,
+    CATEGORY_BLOCKED,
+    CATEGORY_COMPLETE,
+    CATEGORIES,
+};
+
+
+// The number of jobs passing the filters in each section, and the cores and nodes they use or
+// have requested
+struct Summary {
+    unsigned long jobs[CATEGORIES] = {0}, cores[CATEGORIES] = {0}, nodes[CATEGORIES] = {0};
+};
+
+
+// One row of the grouped report: a key's jobs, cores, and nodes in each section, and the
+// core-hours its jobs have left, counting pending jobs' whole time limits
+struct Aggregate {
+    std::string key;
+    Summary summary;
+    double core_hours = 0;
+};
+
+
+// Filter the jobs and sort them into running, idle, blocked, and completed. Large job tables
+// are split across opts.threads threads; the buckets keep the jobs in table order either way.
+void classify_jobs(const Options& opts, const JobTable& jobs, JobBuckets& buckets);
+
+// Count the jobs, cores, and nodes in each section in one pass, without collecting the jobs.
+// Slurm's records can be counted as they are, saving the extraction into a JobTable.
+void summarize_jobs(const Options& opts, const job_info_msg_t *records, Summary& summary);
+void summarize_jobs(const Options& opts, const JobTable& jobs, Summary& summary);
+
+// Total the active, eligible, and blocked jobs by opts.by in one pass, finding each job's row
+// with a single hash lookup. Completed jobs are left out. Jobs submitted to several partitions
+// count in each one opts.partition selects, so jobs is set to the number of jobs counted, each
+// once.
+void aggregate_jobs(const Options& opts, const job_info_msg_t *records, std::vector<Aggregate>& rows,
+    unsigned long& jobs);
+void aggregate_jobs(const Options& opts, const JobTable& jobs, std::vector<Aggregate>& rows,
+    unsigned long& count);
+
+// Order the grouped report's rows by opts.by_order, then by key. With a limit, only the rows
+// which will be shown are ordered.
+void sort_aggregates(const Options& opts, std::vector<Aggregate>& rows);
+
+// Count the nodes used by running jobs and the nodes in the selected partition(s)
+void count_utilization(const Options& opts, const partition_info_msg_t *partitions,
+    JobBuckets& buckets);
+
+// List each job array's tasks in a section on a single row, the first of them in table order,
+// with the tasks it stands for in buckets.arrays
+void compact_arrays(JobBuckets& buckets);
+
+// Order the jobs in each section by the orderby keys, if any. With a limit, only the jobs which
+// will be shown are ordered.
+void sort_jobs(const Options& opts, JobBuckets& buckets);
+
+// Print the requested report to stdout
+void render_report(const Options& opts, const JobBuckets& buckets);
+
+// Print the summary report to stdout
+void render_summary(const Options& opts, const Summary& summary);
+
+// Print the grouped report to stdout, with the number of jobs its rows count
+void render_aggregates(const Options& opts, const std::vector<Aggregate>& rows, unsigned long jobs);
+
+// Filter, sort, and print the requested report from a source's tables
+void print_report(const Options& opts, JobSource& data);
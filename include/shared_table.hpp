@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+#include "sys/types.h"
+
+#include "job_source.hpp"
+#include "job_table.hpp"
+
+
+// Where showqd publishes its tables in shared memory, and where showq looks for them, unless
+// --shm says otherwise. They live in a directory of showqd's own, since anyone can create
+// files in /dev/shm itself.
+const char *const SHOWQD_SHM = "/dev/shm/showqd/tables";
+
+// Tables showqd hasn't refreshed in this many of its intervals are treated as abandoned, both
+// in shared memory and on its socket
+const int STALE_INTERVALS = 3;
+
+
+// The region starts with this header, followed by an offset and count for each of a JobTable's
+// arrays in JobTable::visit order. Everything is addressed by offsets from the start, so
+// readers can map it anywhere.
+struct SharedTableHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t arrays;
+    uint64_t size;  // Bytes in the whole region
+
+    // A seqlock over heartbeat, which showqd updates in place: odd while it's being written
+    uint64_t sequence;
+    int64_t heartbeat;  // When showqd last heard from Slurm
+    uint32_t interval;  // Seconds between showqd's polls
+    uint32_t jobs;
+    int64_t last_update;
+
+    // A snapshot holding the partition table, which is small enough to just parse
+    uint64_t partitions, partitions_size;
+};
+
+
+// Writes showqd's tables into a file under /dev/shm. Each set of tables is written to a new,
+// uniquely named file which is renamed into place, so readers never see one change under them.
+class SharedTablePublisher {
+public:
+    SharedTablePublisher(const std::string& path, unsigned interval)
+        : path_(path), interval_(interval) {}
+    ~SharedTablePublisher();
+
+    SharedTablePublisher(const SharedTablePublisher&) = delete;
+    SharedTablePublisher& operator=(const SharedTablePublisher&) = delete;
+
+    // Check that the tables can be published, creating their directory if it is missing. A
+    // directory or file in the way which another user could have put there is an error. On
+    // failure sets error and returns false.
+    bool prepare(std::string& error);
+
+    bool publish(const JobTable& jobs, const partition_info_msg_t *partitions);
+
+    // Record that the published tables are still current
+    void heartbeat();
+
+private:
+    std::string path_;
+    unsigned interval_;
+    SharedTableHeader *header_ = nullptr;
+    size_t size_ = 0;
+};
+
+
+// Maps the tables showqd published and reports straight from them, without copying the jobs.
+// Only tables written by root, this user, or the owner of showqd's socket are trusted.
+class SharedJobSource : public SnapshotJobSource {
+public:
+    SharedJobSource(const std::string& path, const std::string& socket)
+        : path_(path), socket_(socket) {}
+    ~SharedJobSource();
+
+    // Maps the tables again if showqd has published new ones
+    bool refresh(unsigned tables, bool& changed) override;
+
+protected:
+    bool read() override;
+
+private:
+    void unmap();
+
+    std::string path_, socket_;
+    const char *region_ = nullptr;
+    size_t size_ = 0;
+    dev_t dev_ = 0;
+    ino_t ino_ = 0;
+};
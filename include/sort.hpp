@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "job_table.hpp"
+
+
+// The keys jobs can be ordered by
+enum SortKey {
+    SORT_REMAINING,
+    SORT_REVERSEREMAINING,
+    SORT_JOB,
+    SORT_USER,
+    SORT_STARTTIME,
+    SORT_PRIORITY,
+    SORT_SUBMITTIME,
+};
+
+
+// Parse a comma-separated list of upper case names, ignoring case, into their indexes in the
+// names from begin to end. On failure sets error to the unknown kind of name and returns false.
+bool parse_key_list(const std::string& spec, const char *const *begin, const char *const *end,
+    const std::string& kind, std::vector<size_t>& keys, std::string& error);
+
+// The names from begin to end, separated by commas
+std::string join_names(const char *const *begin, const char *const *end);
+
+// Parse a comma-separated list of key names like "USER,REMAINING", ignoring case. On failure
+// sets error and returns false.
+bool parse_sort_keys(const std::string& spec, std::vector<SortKey>& keys, std::string& error);
+
+// The names of the sort keys, separated by commas
+std::string sort_key_names();
+
+// Stably sort rows of the job table by keys, most significant first. Each row's keys are
+// packed into as few 64-bit integers as their ranges allow, which are then radix sorted. When
+// only the first limit rows will be shown, only those are put in order.
+void sort_rows(const JobTable& jobs, const std::vector<SortKey>& keys, std::vector<uint32_t>& rows,
+    size_t limit = 0);
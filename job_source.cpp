@@ -0,0 +1,445 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "sys/stat.h"
+
+#include "job_source.hpp"
+#include "profile.hpp"
+
+
+SlurmJobSource::SlurmJobSource(bool user_only, uid_t uid) : user_only_(user_only), uid_(uid) {
+    slurm_init((char *) nullptr);
+}
+
+
+SlurmJobSource::~SlurmJobSource() {
+    if (job_records_) slurm_free_job_info_msg(job_records_);
+    if (partitions_) slurm_free_partition_info_msg(partitions_);
+    if (nodes_) slurm_free_node_info_msg(nodes_);
+}
+
+
+// Extract the fields showq uses from Slurm's job records, then free them
+static JobTable* extract(job_info_msg_t *jobs) {
+    ScopedTimer timer("extract");
+    JobTable *table = new JobTable(jobs);
+    timer.records(jobs->record_count);
+    slurm_free_job_info_msg(jobs);
+    return table;
+}
+
+
+bool SlurmJobSource::load(unsigned tables) {
+    // Counting reports can use the records as they are, or a table extracted for another report
+    if ((tables & (TABLE_JOBS | TABLE_JOB_RECORDS)) && !jobs_ && !job_records_) {
+        ScopedTimer timer("rpc:jobs");
+        int rc = user_only_
+            ? slurm_load_job_user(&job_records_, uid_, SHOW_ALL)
+            : slurm_load_jobs( (std::time_t) nullptr, &job_records_, SHOW_ALL);
+        if (rc) return false;
+        timer.records(job_records_->record_count);
+    }
+    if ((tables & TABLE_JOBS) && !jobs_) {
+        jobs_.reset(extract(job_records_));
+        job_records_ = nullptr;
+    }
+    if ((tables & TABLE_PARTITIONS) && !partitions_) {
+        ScopedTimer timer("rpc:partitions");
+        if (slurm_load_partitions( (std::time_t) nullptr, &partitions_, SHOW_ALL)) return false;
+        timer.records(partitions_->record_count);
+    }
+    if ((tables & TABLE_NODES) && !nodes_) {
+        ScopedTimer timer("rpc:nodes");
+        if (slurm_load_node( (std::time_t) nullptr, &nodes_, SHOW_ALL)) return false;
+        timer.records(nodes_->record_count);
+    }
+    return true;
+}
+
+
+template <typename Msg>
+static void replace(Msg *&current, Msg *fresh, void (*free_msg)(Msg *), bool& changed) {
+    if (!fresh) return;
+    if (current) free_msg(current);
+    current = fresh;
+    changed = true;
+}
+
+
+bool SlurmJobSource::refresh(unsigned tables, bool& changed) {
+    changed = false;
+    if (tables & (TABLE_JOBS | TABLE_JOB_RECORDS)) {
+        std::time_t last_update = jobs_ ? jobs_->last_update : job_records_ ? job_records_->last_update : 0;
+        job_info_msg_t *fresh = nullptr;
+        {
+            ScopedTimer timer("rpc:jobs");
+            if (user_only_) {
+                // Per-user loads take no update time, so compare the snapshots' timestamps
+                if (slurm_load_job_user(&fresh, uid_, SHOW_ALL)) return false;
+                if ((jobs_ || job_records_) && fresh->last_update == last_update) {
+                    slurm_free_job_info_msg(fresh);
+                    fresh = nullptr;
+                }
+            } else if (slurm_load_jobs(last_update, &fresh, SHOW_ALL)) {
+                fresh = nullptr;
+                if (slurm_get_errno() != SLURM_NO_CHANGE_IN_DATA) return false;
+            }
+            if (fresh) timer.records(fresh->record_count);
+        }
+        if (fresh) {
+            // Keep the new jobs in the form asked for, dropping the old ones in either form
+            jobs_.reset();
+            if (job_records_) slurm_free_job_info_msg(job_records_);
+            job_records_ = nullptr;
+            if (tables & TABLE_JOBS) {
+                jobs_.reset(extract(fresh));
+            } else {
+                job_records_ = fresh;
+            }
+            changed = true;
+        }
+    }
+    if (tables & TABLE_PARTITIONS) {
+        ScopedTimer timer("rpc:partitions");
+        partition_info_msg_t *fresh = nullptr;
+        if (slurm_load_partitions(partitions_ ? partitions_->last_update : 0, &fresh, SHOW_ALL)) {
+            fresh = nullptr;
+            if (slurm_get_errno() != SLURM_NO_CHANGE_IN_DATA) return false;
+        }
+        if (fresh) timer.records(fresh->record_count);
+        replace(partitions_, fresh, slurm_free_partition_info_msg, changed);
+    }
+    if (tables & TABLE_NODES) {
+        ScopedTimer timer("rpc:nodes");
+        node_info_msg_t *fresh = nullptr;
+        if (slurm_load_node(nodes_ ? nodes_->last_update : 0, &fresh, SHOW_ALL)) {
+            fresh = nullptr;
+            if (slurm_get_errno() != SLURM_NO_CHANGE_IN_DATA) return false;
+        }
+        if (fresh) timer.records(fresh->record_count);
+        replace(nodes_, fresh, slurm_free_node_info_msg, changed);
+    }
+    return true;
+}
+
+
+// Snapshot layout: magic, version, the set of tables present, then each table as its
+// last_update, record count, and records. Strings are a length (or NULL_STRING) followed by
+// the NUL-terminated bytes, and node indexes are a count followed by the 4-byte aligned,
+// -1 terminated array, so that the loaded tables can point straight into the buffer.
+static const char SNAPSHOT_MAGIC[8] = {'S', 'H', 'O', 'W', 'Q', 'S', 'N', 'P'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const uint32_t NULL_STRING = 0xffffffff;
+
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(std::vector<char>& out) : out_(out) {}
+
+    template <typename T>
+    void put(T value) {
+        const char *bytes = reinterpret_cast<const char *>(&value);
+        out_.insert(out_.end(), bytes, bytes + sizeof(T));
+    }
+
+    void str(const char *s) {
+        if (!s) {
+            put<uint32_t>(NULL_STRING);
+            return;
+        }
+        uint32_t len = std::strlen(s);
+        put<uint32_t>(len);
+        out_.insert(out_.end(), s, s + len + 1);
+    }
+
+    void inx(const int32_t *inx) {
+        if (!inx) {
+            put<uint32_t>(NULL_STRING);
+            return;
+        }
+        uint32_t count = 0;
+        while (inx[count] != -1) count++;
+        put<uint32_t>(count);
+        out_.resize((out_.size() + 3) & ~size_t(3), '\0');
+        for (uint32_t i = 0; i <= count; i++) put<int32_t>(inx[i]);
+    }
+
+private:
+    std::vector<char>& out_;
+};
+
+
+class SnapshotReader {
+public:
+    SnapshotReader(char *data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    T get() {
+        T value = T();
+        if (!ok_ || pos_ + sizeof(T) > size_) {
+            ok_ = false;
+            return value;
+        }
+        std::memcpy(&value, data_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    char* str() {
+        uint32_t len = get<uint32_t>();
+        if (!ok_ || len == NULL_STRING) return nullptr;
+        if (pos_ + len + 1 > size_ || data_[pos_ + len] != '\0') {
+            ok_ = false;
+            return nullptr;
+        }
+        char *s = data_ + pos_;
+        pos_ += len + 1;
+        return s;
+    }
+
+    int32_t* inx() {
+        uint32_t count = get<uint32_t>();
+        if (!ok_ || count == NULL_STRING) return nullptr;
+        pos_ = (pos_ + 3) & ~size_t(3);
+        if (pos_ + (count + 1) * sizeof(int32_t) > size_) {
+            ok_ = false;
+            return nullptr;
+        }
+        // Readers of the array stop at its -1, so it must be there
+        int32_t *inx = reinterpret_cast<int32_t *>(data_ + pos_);
+        if (inx[count] != -1) {
+            ok_ = false;
+            return nullptr;
+        }
+        pos_ += (count + 1) * sizeof(int32_t);
+        return inx;
+    }
+
+    size_t remaining() const { return size_ - pos_; }
+    bool ok() const { return ok_; }
+    bool done() const { return ok_ && pos_ == size_; }
+
+private:
+    char *data_;
+    size_t size_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+
+static void put_job(SnapshotWriter& w, const JobTable& t, uint32_t row) {
+    w.put<uint32_t>(t.job_id[row]);
+    w.put<uint32_t>(t.array_job_id[row]);
+    w.put<uint32_t>(t.array_task_id[row]);
+    w.put<uint32_t>(t.user_id[row]);
+    w.put<uint32_t>(t.group_id[row]);
+    w.put<uint32_t>(t.job_state[row]);
+    w.put<uint32_t>(t.state_reason[row]);
+    w.put<uint32_t>(t.exit_code[row]);
+    w.put<uint32_t>(t.priority[row]);
+    w.put<uint32_t>(t.time_limit[row]);
+    w.put<uint32_t>(t.num_tasks[row]);
+    w.put<uint32_t>(t.num_cpus[row]);
+    w.put<uint32_t>(t.num_nodes[row]);
+    w.put<int64_t>(t.submit_time[row]);
+    w.put<int64_t>(t.eligible_time[row]);
+    w.put<int64_t>(t.start_time[row]);
+    w.put<int64_t>(t.end_time[row]);
+    w.str(t.name[row]);
+    w.str(t.account[row]);
+    w.str(t.partition[row]);
+    w.str(t.qos[row]);
+    w.str(t.resv_name[row]);
+    w.str(t.batch_host[row]);
+    w.str(t.nodes[row]);
+    w.str(t.array_task_str[row]);
+    w.inx(t.node_inx(row));
+}
+
+
+static void get_job(SnapshotReader& r, job_info_t& j) {
+    j.job_id = r.get<uint32_t>();
+    j.array_job_id = r.get<uint32_t>();
+    j.array_task_id = r.get<uint32_t>();
+    j.user_id = r.get<uint32_t>();
+    j.group_id = r.get<uint32_t>();
+    j.job_state = r.get<uint32_t>();
+    j.state_reason = r.get<uint32_t>();
+    j.exit_code = r.get<uint32_t>();
+    j.priority = r.get<uint32_t>();
+    j.time_limit = r.get<uint32_t>();
+    j.num_tasks = r.get<uint32_t>();
+    j.num_cpus = r.get<uint32_t>();
+    j.num_nodes = r.get<uint32_t>();
+    j.submit_time = r.get<int64_t>();
+    j.eligible_time = r.get<int64_t>();
+    j.start_time = r.get<int64_t>();
+    j.end_time = r.get<int64_t>();
+    j.name = r.str();
+    j.account = r.str();
+    j.partition = r.str();
+    j.qos = r.str();
+    j.resv_name = r.str();
+    j.batch_host = r.str();
+    j.nodes = r.str();
+    j.array_task_str = r.str();
+    j.node_inx = r.inx();
+}
+
+
+std::vector<char> serialize_snapshot(const JobTable *jobs,
+        const partition_info_msg_t *partitions, const node_info_msg_t *nodes) {
+    std::vector<char> out(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + sizeof(SNAPSHOT_MAGIC));
+    SnapshotWriter w(out);
+    w.put<uint32_t>(SNAPSHOT_VERSION);
+    w.put<uint32_t>((jobs ? TABLE_JOBS : 0) | (partitions ? TABLE_PARTITIONS : 0)
+        | (nodes ? TABLE_NODES : 0));
+
+    if (jobs) {
+        w.put<int64_t>(jobs->last_update);
+        w.put<uint32_t>(jobs->size());
+        for (uint32_t row = 0; row < jobs->size(); row++) put_job(w, *jobs, row);
+    }
+    if (partitions) {
+        w.put<int64_t>(partitions->last_update);
+        w.put<uint32_t>(partitions->record_count);
+        for (unsigned i = 0; i < partitions->record_count; i++) {
+            const partition_info_t& p = partitions->partition_array[i];
+            w.put<uint32_t>(p.total_nodes);
+            w.put<uint32_t>(p.total_cpus);
+            w.str(p.name);
+            w.str(p.nodes);
+            w.inx(p.node_inx);
+        }
+    }
+    if (nodes) {
+        w.put<int64_t>(nodes->last_update);
+        w.put<uint32_t>(nodes->record_count);
+        for (unsigned i = 0; i < nodes->record_count; i++) w.str(nodes->node_array[i].name);
+    }
+    return out;
+}
+
+
+bool write_snapshot(const std::string& path, JobSource& source) {
+    if (!source.load(TABLE_ALL)) return false;
+    std::vector<char> out = serialize_snapshot(source.jobs(), source.partitions(), source.nodes());
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(out.data(), out.size());
+    return file.good();
+}
+
+
+SnapshotJobSource::SnapshotJobSource(const std::string& path) : path_(path) {
+    std::memset(&partition_msg_, 0, sizeof(partition_msg_));
+    std::memset(&node_msg_, 0, sizeof(node_msg_));
+}
+
+
+bool SnapshotJobSource::load(unsigned tables) {
+    if (!loaded_ && !read()) return false;
+    return (jobs_ || !(tables & (TABLE_JOBS | TABLE_JOB_RECORDS)))
+        && (partitions_ || !(tables & TABLE_PARTITIONS))
+        && (nodes_ || !(tables & TABLE_NODES));
+}
+
+
+bool SnapshotJobSource::refresh(unsigned tables, bool& changed) {
+    changed = false;
+    struct stat st;
+    if (stat(path_.c_str(), &st)) return false;
+    if (loaded_ && st.st_mtime == mtime_) return true;
+    if (!read()) return false;
+    changed = true;
+    return load(tables);
+}
+
+
+bool SnapshotJobSource::read() {
+    ScopedTimer timer("snapshot");
+    struct stat st;
+    std::ifstream file(path_, std::ios::binary);
+    if (!file || stat(path_.c_str(), &st)) {
+        std::cerr << "Unable to open snapshot " << path_ << std::endl;
+        return false;
+    }
+    mtime_ = st.st_mtime;
+    std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!parse(std::move(buffer))) {
+        std::cerr << "Unable to read snapshot " << path_ << std::endl;
+        return false;
+    }
+    timer.records(jobs_ ? jobs_->size() : 0);
+    return true;
+}
+
+
+bool SnapshotJobSource::parse(std::vector<char>&& buffer) {
+    jobs_.reset();
+    partitions_ = nullptr;
+    nodes_ = nullptr;
+    loaded_ = false;
+    buffer_ = std::move(buffer);
+    if (buffer_.size() < sizeof(SNAPSHOT_MAGIC)
+            || std::memcmp(buffer_.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC))) {
+        return false;
+    }
+
+    SnapshotReader r(buffer_.data(), buffer_.size());
+    r.get<uint64_t>();
+    if (r.get<uint32_t>() != SNAPSHOT_VERSION) return false;
+    unsigned tables = r.get<uint32_t>();
+
+    std::unique_ptr<JobTable> jobs;
+    if (tables & TABLE_JOBS) {
+        jobs.reset(new JobTable());
+        jobs->last_update = r.get<int64_t>();
+        uint32_t count = r.get<uint32_t>();
+        if (!r.ok() || count > r.remaining()) return false;
+        jobs->reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            job_info_t j;
+            get_job(r, j);
+            if (!r.ok()) return false;
+            jobs->append(j);
+        }
+    }
+    if (tables & TABLE_PARTITIONS) {
+        partition_msg_.last_update = r.get<int64_t>();
+        uint32_t count = r.get<uint32_t>();
+        if (!r.ok() || count > r.remaining()) return false;
+        partition_array_.assign(count, partition_info_t());
+        for (partition_info_t& p : partition_array_) {
+            p.total_nodes = r.get<uint32_t>();
+            p.total_cpus = r.get<uint32_t>();
+            p.name = r.str();
+            p.nodes = r.str();
+            p.node_inx = r.inx();
+            if (!r.ok()) return false;
+        }
+        partition_msg_.record_count = partition_array_.size();
+        partition_msg_.partition_array = partition_array_.data();
+    }
+    if (tables & TABLE_NODES) {
+        node_msg_.last_update = r.get<int64_t>();
+        uint32_t count = r.get<uint32_t>();
+        if (!r.ok() || count > r.remaining()) return false;
+        node_array_.assign(count, node_info_t());
+        for (node_info_t& n : node_array_) {
+            n.name = r.str();
+            if (!r.ok()) return false;
+        }
+        node_msg_.record_count = node_array_.size();
+        node_msg_.node_array = node_array_.data();
+    }
+    if (!r.done()) return false;
+
+    jobs_ = std::move(jobs);
+    if (tables & TABLE_PARTITIONS) partitions_ = &partition_msg_;
+    if (tables & TABLE_NODES) nodes_ = &node_msg_;
+    loaded_ = true;
+    return true;
+}
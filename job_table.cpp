@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+
+#include "job_table.hpp"
+
+
+const StringPool::Id StringPool::NULL_ID;
+const uint32_t JobTable::NO_NODE_INX;
+
+
+// FNV-1a
+static uint32_t hash_string(const char *s, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= static_cast<unsigned char>(s[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+StringPool::StringPool() : offsets_(1, 0), hashes_(1, 0), slots_(16, 0) {}
+
+
+StringPool::Id StringPool::intern(const char *s) {
+    if (!s) return NULL_ID;
+    size_t len = std::strlen(s);
+    uint32_t hash = hash_string(s, len);
+    if (offsets_.size() * 2 >= slots_.size()) grow();
+
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        Id id = slots_[i];
+        if (id == 0) {
+            id = offsets_.size();
+            offsets_.push_back(heap_.size());
+            hashes_.push_back(hash);
+            heap_.append(s, len + 1);
+            slots_.set(i, id);
+            return id;
+        }
+        if (hashes_[id] == hash && std::strcmp(&heap_[offsets_[id]], s) == 0) return id;
+    }
+}
+
+
+void StringPool::grow() {
+    slots_.assign(slots_.size() * 2, 0);
+    size_t mask = slots_.size() - 1;
+    for (Id id = 1; id < offsets_.size(); id++) {
+        size_t i = hashes_[id] & mask;
+        while (slots_[i]) i = (i + 1) & mask;
+        slots_.set(i, id);
+    }
+}
+
+
+bool StringPool::valid() const {
+    if (offsets_.size() == 0 || hashes_.size() != offsets_.size()) return false;
+    if (slots_.size() == 0 || (slots_.size() & (slots_.size() - 1))) return false;
+    if (heap_.size() && heap_[heap_.size() - 1] != '\0') return false;
+    for (size_t id = 1; id < offsets_.size(); id++) {
+        if (offsets_[id] >= heap_.size()) return false;
+    }
+    for (size_t i = 0; i < slots_.size(); i++) {
+        if (slots_[i] >= offsets_.size()) return false;
+    }
+    return true;
+}
+
+
+bool StringColumn::valid(uint32_t rows) const {
+    if (ids_.size() != rows || !pool_.valid()) return false;
+    StringPool::Id max = 0;
+    for (uint32_t row = 0; row < rows; row++) max = std::max(max, ids_[row]);
+    return max < pool_.size();
+}
+
+
+bool JobTable::valid() const {
+    uint32_t rows = size();
+    for (const Array<uint32_t> *column : {&job_id, &array_job_id, &array_task_id, &user_id,
+            &group_id, &job_state, &state_reason, &exit_code, &priority, &time_limit, &num_tasks,
+            &num_cpus, &num_nodes, &node_inx_start}) {
+        if (column->size() != rows) return false;
+    }
+    for (const Array<std::time_t> *column : {&submit_time, &eligible_time, &start_time, &end_time}) {
+        if (column->size() != rows) return false;
+    }
+    for (const StringColumn *column : {&name, &account, &partition, &qos, &resv_name, &batch_host,
+            &nodes, &array_task_str}) {
+        if (!column->valid(rows)) return false;
+    }
+
+    // Node indexes are read up to a -1, so the last array must end with one
+    if (node_inx_data.size() && node_inx_data[node_inx_data.size() - 1] != -1) return false;
+    for (uint32_t row = 0; row < rows; row++) {
+        uint32_t start = node_inx_start[row];
+        if (start != NO_NODE_INX && start >= node_inx_data.size()) return false;
+    }
+    return true;
+}
+
+
+JobTable::JobTable(const job_info_msg_t *jobs) {
+    last_update = jobs->last_update;
+    reserve(jobs->record_count);
+    for (unsigned i = 0; i < jobs->record_count; i++) append(jobs->job_array[i]);
+}
+
+
+void JobTable::append(const job_info_t& job) {
+    job_id.push_back(job.job_id);
+    array_job_id.push_back(job.array_job_id);
+    array_task_id.push_back(job.array_task_id);
+    user_id.push_back(job.user_id);
+    group_id.push_back(job.group_id);
+    job_state.push_back(job.job_state);
+    state_reason.push_back(job.state_reason);
+    exit_code.push_back(job.exit_code);
+    priority.push_back(job.priority);
+    time_limit.push_back(job.time_limit);
+    num_tasks.push_back(job.num_tasks);
+    num_cpus.push_back(job.num_cpus);
+    num_nodes.push_back(job.num_nodes);
+    submit_time.push_back(job.submit_time);
+    eligible_time.push_back(job.eligible_time);
+    start_time.push_back(job.start_time);
+    end_time.push_back(job.end_time);
+    name.push_back(job.name);
+    account.push_back(job.account);
+    partition.push_back(job.partition);
+    qos.push_back(job.qos);
+    resv_name.push_back(job.resv_name);
+    batch_host.push_back(job.batch_host);
+    nodes.push_back(job.nodes);
+    array_task_str.push_back(job.array_task_str);
+
+    if (!job.node_inx) {
+        node_inx_start.push_back(NO_NODE_INX);
+        return;
+    }
+    node_inx_start.push_back(node_inx_data.size());
+    const int32_t *inx = job.node_inx;
+    do {
+        node_inx_data.push_back(*inx);
+    } while (*inx++ != -1);
+}
+
+
+void JobTable::reserve(size_t n) {
+    for (Array<uint32_t> *column : {&job_id, &array_job_id, &array_task_id, &user_id,
+            &group_id, &job_state, &state_reason, &exit_code, &priority, &time_limit, &num_tasks,
+            &num_cpus, &num_nodes, &node_inx_start}) {
+        column->reserve(n);
+    }
+    for (Array<std::time_t> *column : {&submit_time, &eligible_time, &start_time, &end_time}) {
+        column->reserve(n);
+    }
+    for (StringColumn *column : {&name, &account, &partition, &qos, &resv_name, &batch_host,
+            &nodes, &array_task_str}) {
+        column->reserve(n);
+    }
+}
@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#include "identity.hpp"
+#include "layout.hpp"
+
+
+typedef Layout::Column Column;
+
+
+const char* state2cstr(unsigned int state) {
+    switch(state) {
+        case JOB_PENDING: return "Idle";
+        case JOB_RUNNING: return "Running";
+        case JOB_SUSPENDED: return "Suspended";
+        case JOB_COMPLETE: return "Complete";
+        case JOB_CANCELLED: return "Cancelled";
+        case JOB_FAILED: return "Failed";
+        case JOB_TIMEOUT: return "TimeOut";
+        case JOB_NODE_FAIL: return "NodeFail";
+        case JOB_PREEMPTED: return "Preempted";
+        case JOB_BOOT_FAIL: return "BootFail";
+        case JOB_DEADLINE: return "Deadline";
+        case JOB_OOM: return "OomError";
+        default: return "Unknown";
+    }
+}
+
+
+static double calc_xfactor(const JobTable& jobs, uint32_t row, std::time_t now) {
+    time_t until = (jobs.job_state[row] == JOB_PENDING) ? now : jobs.start_time[row];
+    return std::max(1.0, std::difftime(until, jobs.eligible_time[row]) / (jobs.time_limit[row] * 60));
+}
+
+
+// printf prints missing strings as "(null)", so keep showing them that way
+static const char* str_or_null(const char *s) {
+    return s ? s : "(null)";
+}
+
+
+static const char* str_or_empty(const char *s) {
+    return s ? s : "";
+}
+
+
+static void text(OutputBuffer& out, const Column& col, const char *s) {
+    if (col.left) {
+        out.left(s, col.width, col.max);
+    } else {
+        out.right(s, col.width, col.max);
+    }
+}
+
+
+static void number(OutputBuffer& out, const Column& col, unsigned long value) {
+    if (col.left) {
+        out.left(value, col.width);
+    } else {
+        out.right(value, col.width);
+    }
+}
+
+
+static void duration(OutputBuffer& out, const Column& col, int seconds) {
+    char buf[DURATION_MAX];
+    out.pad(buf, std::min(format_duration(buf, seconds), col.max), col.width, col.left);
+}
+
+
+static void timestamp(OutputBuffer& out, const Column& col, RowContext& ctx, std::time_t t) {
+    char buf[TIMESTAMP_LEN];
+    out.pad(buf, std::min(ctx.timestamps.format(buf, t), col.max), col.width, col.left);
+}
+
+
+// A job array's row, as ARRAYID_[tasks](count). Ranges too long for max are cut short with
+// "...", keeping the count.
+static std::string array_id(uint32_t array_job_id, const ArrayTasks& array, size_t max) {
+    std::string head = std::to_string(array_job_id) + "_[";
+    std::string tail = "](" + std::to_string(array.count) + ")";
+    if (head.size() + array.tasks.size() + tail.size() <= max) return head + array.tasks + tail;
+    tail = "..." + tail;
+    if (head.size() + tail.size() >= max) return (head + array.tasks + tail).substr(0, max);
+    return head + array.tasks.substr(0, max - head.size() - tail.size()) + tail;
+}
+
+
+// Job names and array task ranges are cut to the column's width so that they line up like the
+// IDs they replace
+static void jobid(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    size_t max = col.max != std::string::npos || !col.width ? col.max : col.width;
+    const ArrayTasks *array = ctx.array(row);
+    if (ctx.jobname) {
+        const char *name = str_or_empty(ctx.jobs.name[row]);
+        out.pad(name, strnlen(name, max), col.width, col.left);
+    } else if (array) {
+        std::string id = array_id(ctx.jobs.array_job_id[row], *array, max);
+        out.pad(id.data(), id.size(), col.width, col.left);
+    } else {
+        number(out, col, ctx.jobs.job_id[row]);
+    }
+}
+
+
+static void tasks(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    const ArrayTasks *array = ctx.array(row);
+    number(out, col, array ? array->count : 1);
+}
+
+
+static void name(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    text(out, col, str_or_empty(ctx.jobs.name[row]));
+}
+
+
+static void state(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    text(out, col, state2cstr(ctx.jobs.job_state[row]));
+}
+
+
+static void exitcode(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    number(out, col, ctx.jobs.exit_code[row]);
+}
+
+
+static void partition(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    text(out, col, str_or_empty(ctx.jobs.partition[row]));
+}
+
+
+static void account(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    text(out, col, str_or_empty(ctx.jobs.account[row]));
+}
+
+
+static void qos(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    text(out, col, str_or_empty(ctx.jobs.qos[row]));
+}
+
+
+static void reservation(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    text(out, col, str_or_empty(ctx.jobs.resv_name[row]));
+}
+
+
+static void xfactor(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    out.fixed1(calc_xfactor(ctx.jobs, row, ctx.now), col.width, col.left);
+}
+
+
+static void user(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    text(out, col, uid2name(ctx.jobs.user_id[row]).c_str());
+}
+
+
+static void group(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    text(out, col, gid2name(ctx.jobs.group_id[row]).c_str());
+}
+
+
+static void mhost(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    text(out, col, str_or_null(ctx.jobs.batch_host[row]));
+}
+
+
+static void nodes(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    text(out, col, str_or_null(ctx.jobs.nodes[row]));
+}
+
+
+static void numnodes(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    number(out, col, ctx.jobs.num_nodes[row]);
+}
+
+
+static void procs(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    number(out, col, ctx.jobs.num_tasks[row]);
+}
+
+
+static void cpus(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    number(out, col, ctx.jobs.num_cpus[row]);
+}
+
+
+static void priority(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    number(out, col, ctx.jobs.priority[row]);
+}
+
+
+static void remaining(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    duration(out, col, std::difftime(ctx.jobs.end_time[row], ctx.now));
+}
+
+
+static void walltime(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    duration(out, col, std::difftime(ctx.jobs.end_time[row], ctx.jobs.start_time[row]));
+}
+
+
+static void wclimit(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    duration(out, col, ctx.jobs.time_limit[row] * 60);
+}
+
+
+static void submittime(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    timestamp(out, col, ctx, ctx.jobs.submit_time[row]);
+}
+
+
+static void starttime(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    timestamp(out, col, ctx, ctx.jobs.start_time[row]);
+}
+
+
+static void endtime(OutputBuffer& out, const Column& col, RowContext& ctx, uint32_t row) {
+    timestamp(out, col, ctx, ctx.jobs.end_time[row]);
+}
+
+
+struct Field {
+    const char *name, *title;
+    Layout::Append append;
+};
+
+
+static const Field FIELDS[] = {
+    {"jobid", "JOBID", jobid},
+    {"tasks", "TASKS", tasks},
+    {"name", "NAME", name},
+    {"state", "STATE", state},
+    {"exitcode", "CCODE", exitcode},
+    {"partition", "PAR", partition},
+    {"account", "ACCOUNT", account},
+    {"qos", "Q", qos},
+    {"reservation", "RESERVATION", reservation},
+    {"xfactor", "XFACTOR", xfactor},
+    {"user", "USERNAME", user},
+    {"group", "GROUP", group},
+    {"mhost", "MHOST", mhost},
+    {"nodes", "NODES", nodes},
+    {"numnodes", "NODES", numnodes},
+    {"procs", "PROCS", procs},
+    {"cpus", "CPUS", cpus},
+    {"priority", "PRIORITY", priority},
+    {"remaining", "REMAINING", remaining},
+    {"walltime", "WALLTIME", walltime},
+    {"wclimit", "WCLIMIT", wclimit},
+    {"submittime", "QUEUETIME", submittime},
+    {"starttime", "STARTTIME", starttime},
+    {"endtime", "ENDTIME", endtime},
+};
+
+
+bool Layout::compile(const std::string& spec, std::string& error) {
+    columns_.clear();
+    suffix_.clear();
+    std::string literal;
+    for (size_t i = 0; i < spec.size(); ) {
+        if (spec[i] != '%') {
+            literal += spec[i++];
+            continue;
+        }
+        if (i + 1 < spec.size() && spec[i + 1] == '%') {
+            literal += '%';
+            i += 2;
+            continue;
+        }
+
+        // %[-][width][.max]field[{title}]
+        size_t start = i++;
+        Column col;
+        col.prefix = literal;
+        col.left = i < spec.size() && spec[i] == '-';
+        if (col.left) i++;
+        col.width = 0;
+        while (i < spec.size() && std::isdigit(spec[i])) col.width = col.width * 10 + (spec[i++] - '0');
+        col.max = std::string::npos;
+        if (i < spec.size() && spec[i] == '.') {
+            col.max = 0;
+            for (i++; i < spec.size() && std::isdigit(spec[i]); i++) col.max = col.max * 10 + (spec[i] - '0');
+        }
+        std::string field;
+        while (i < spec.size() && std::isalpha(spec[i])) field += std::tolower(spec[i++]);
+
+        const Field *match = nullptr;
+        for (const Field& f : FIELDS) {
+            if (field == f.name) match = &f;
+        }
+        if (!match) {
+            error = "Unknown field in format: " + spec.substr(start, i - start);
+            return false;
+        }
+        col.append = match->append;
+        col.title = match->title;
+        if (i < spec.size() && spec[i] == '{') {
+            size_t close = spec.find('}', i);
+            if (close == std::string::npos) {
+                error = "Unterminated title in format: " + spec.substr(start);
+                return false;
+            }
+            col.title = spec.substr(i + 1, close - i - 1);
+            i = close + 1;
+        }
+        columns_.push_back(col);
+        literal.clear();
+    }
+    suffix_ = literal;
+    return true;
+}
+
+
+void Layout::header(OutputBuffer& out) const {
+    for (const Column& col : columns_) {
+        out.str(col.prefix);
+        out.pad(col.title.data(), col.title.size(), col.width, col.left);
+    }
+    out.str(suffix_);
+}
+
+
+void Layout::row(OutputBuffer& out, RowContext& ctx, uint32_t row) const {
+    for (const Column& col : columns_) {
+        out.str(col.prefix);
+        col.append(out, col, ctx, row);
+    }
+    out.str(suffix_);
+}
+
+
+std::string Layout::field_names() {
+    std::string names;
+    for (const Field& f : FIELDS) {
+        if (!names.empty()) names += ' ';
+        names += f.name;
+    }
+    return names;
+}
@@ -1,91 +1,73 @@
-#include <algorithm>
-#include <cctype>
-#include <cmath>
-#include <ctime>
+#include <csignal>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <string>
-#include <sstream>
-#include <vector>
 
-#include "grp.h"
-#include "pwd.h"
-
-#include "slurm/slurm.h"
+#include "unistd.h"
 
 #include "CLI11.hpp"
+#include "daemon.hpp"
+#include "filter.hpp"
+#include "identity.hpp"
+#include "job_source.hpp"
+#include "layout.hpp"
+#include "profile.hpp"
+#include "reasons.hpp"
+#include "report.hpp"
+#include "shared_table.hpp"
+#include "sort.hpp"
 
 
-std::string jobid_or_name(job_info_t *ji, bool name) {
-    std::stringstream ss;
-    if (name) {
-        ss << ji->name;
-    } else {
-        ss << ji->job_id;
+// Prints lookup counters and the profile to stderr when the report finishes, however main() exits
+struct StatsReporter {
+    bool enabled = false;
+    std::string profile;
+    ~StatsReporter() {
+        if (enabled) {
+            IdentityCache& ids = IdentityCache::instance();
+            std::cerr << "NSS lookups: " << ids.lookups() << " (" << ids.users() << " users, "
+                << ids.groups() << " groups)\n";
+        }
+        if (profile == "json") {
+            Profiler::instance().print_json(std::cerr);
+        } else if (profile != "") {
+            Profiler::instance().print_text(std::cerr);
+        }
     }
-    return ss.str();
-}
+};
 
 
-std::string uid2name(unsigned int uid) {
-    passwd *pw = getpwuid(uid);
-    return (pw) ? std::string(pw->pw_name) : std::to_string(uid);
-}
+// Set by SIGINT or SIGTERM, which end --watch mode
+static volatile sig_atomic_t stopping = 0;
 
 
-std::string gid2name(unsigned int gid) {
-    group *gp = getgrgid(gid);
-    return (gp) ? std::string(gp->gr_name) : std::to_string(gid);
+static void stop(int) {
+    stopping = 1;
 }
 
 
-const char* state2cstr(unsigned int state) {
-    switch(state) {
-        case JOB_PENDING: return "Idle";
-        case JOB_RUNNING: return "Running";
-        case JOB_SUSPENDED: return "Suspended"; 
-        case JOB_COMPLETE: return "Complete";
-        case JOB_CANCELLED: return "Cancelled";
-        case JOB_FAILED: return "Failed";
-        case JOB_TIMEOUT: return "TimeOut";
-        case JOB_NODE_FAIL: return "NodeFail";
-        case JOB_PREEMPTED: return "Preempted";
-        case JOB_BOOT_FAIL: return "BootFail";
-        case JOB_DEADLINE: return "Deadline";
-        case JOB_OOM: return "OomError";
-        default: return "Unknown";
+// Load only the Slurm tables needed by the report, from showqd's shared memory or socket if
+// it's running. Otherwise when filtering on a user, let slurmctld do the filtering so only
+// their jobs are sent. Returns null if none of them can be loaded.
+static std::unique_ptr<JobSource> load_source(const Options& opts, const std::string& shm,
+        const std::string& socket) {
+    unsigned tables = report_tables(opts.report);
+    std::unique_ptr<JobSource> source;
+    if (shm != "") {
+        source.reset(new SharedJobSource(shm, socket));
+        if (source->load(tables)) return source;
     }
-}
-
-
-std::string timestamp2str(time_t t) {
-    std::string raw(std::ctime(&t));
-    return raw.substr(0, raw.size() - 6);
-}
-
-
-std::string duration2str(int dur_sec) {
-    std::stringstream ss;
-    if (dur_sec < 0) {
-        dur_sec = -dur_sec;
-        ss << '-';
-    }
-    
-    if (dur_sec / 60 / 60 / 24 > 0) {
-        ss << (dur_sec / 60 / 60 / 24) << ':' 
-           << std::setw(2) << std::setfill('0') << (dur_sec / 60 / 60) % 24 << ':';
-    } else {
-        ss << (dur_sec / 60 / 60) % 24 << ':';
+    if (socket != "") {
+        source.reset(new DaemonJobSource(socket));
+        if (source->load(tables)) return source;
     }
-
-    ss << std::setw(2) << std::setfill('0') << (dur_sec / 60) % 60 << ':' 
-       << std::setw(2) << std::setfill('0') << (dur_sec) % 60;
-    return ss.str();
-}
-
-
-double calc_xfactor(job_info_t *j) {
-    time_t until = (j->job_state == JOB_PENDING) ? std::time(nullptr) : j->start_time;
-    return std::max(1.0, std::difftime(until, j->eligible_time) / (j->time_limit * 60));
+    // Slurm can send a single user's jobs alone
+    uint32_t uid = 0;
+    bool single_user = opts.users.single(uid);
+    source.reset(new SlurmJobSource(single_user, uid));
+    if (source->load(tables)) return source;
+    return nullptr;
 }
 
 
@@ -93,284 +75,226 @@ int main(int argc, char** argv) {
 
     // Define and set up the cli flags and options for controlling the printing
     CLI::App app{"A Slurm-compatible implementation of Maui's showq."};
-    bool blocking = false, idle = false, running = false, completed = false;
-    bool summary = false, jobname = false, nodes = false;
-    std::string partition, reservation, username, groupname, account, qosname, orderby;
-    auto order_validator = CLI::IsMember(
-        {"REMAINING", "REVERSEREMAINING", "JOB", "USER", "STARTTIME"}, CLI::ignore_case
-    );
+    bool blocking = false, idle = false, running = false, completed = false, summary = false;
+    unsigned watch = 0, interval = 10;
+    std::string snapshot, dump_snapshot, orderby, by, output = "text";
+    std::string config = SHOWQ_CONFIG, blocked_reasons, reasons;
+    std::string username, groupname, account, partition, qosname, reservation;
+    std::string socket = SHOWQD_SOCKET, shm = SHOWQD_SHM;
+
+    // Installed as a link named showqd, the binary runs as the daemon
+    const char *slash = std::strrchr(argv[0], '/');
+    bool daemon = std::strcmp(slash ? slash + 1 : argv[0], "showqd") == 0;
+    bool allow_private = false;
+    StatsReporter stats;
+    Options opts;
+
+    auto reason_list = [](const std::string& spec) {
+        ReasonSet reasons;
+        std::string error;
+        return parse_reasons(spec, reasons, error) ? std::string() : error;
+    };
+
+    // Filters take comma-separated lists, with ! excluding a value. Account, partition, QoS,
+    // and reservation values may also be globs like "gpu*", or regexes after a ~.
+    auto patterns = [](const std::string& spec) {
+        StringFilter filter;
+        std::string error;
+        return filter.compile(spec, error) ? std::string() : error;
+    };
 
     app.add_flag("-b,--blocking", blocking, "Show blocked jobs");
     app.add_flag("-i,--idle", idle, "Show idle jobs");
     app.add_flag("-r,--running", running, "Show running jobs");
     app.add_flag("-c,--completed", completed, "Show completed jobs");
     app.add_flag("-s,--summary", summary, "Show workload summary");
-    app.add_flag("-n,--names", jobname, "Show job names instead of job IDs");
-    app.add_flag("-N,--nodes", nodes, "Show nodes allocated to running jobs");
-    app.add_option("-o,--orderby", orderby, "Sort running jobs by a specific attribute")->check(order_validator);
-    app.add_option("-u,--username", username, "Show jobs for a specific user");
-    app.add_option("-g,--group", groupname, "Show jobs for a specific group");
-    app.add_option("-a,--account", account, "Show jobs for a specific account");
-    app.add_option("-p,--partition", partition, "Show jobs for a specific partition");
-    app.add_option("-q,--qos", qosname, "Show jobs for a specific QoS");
-    app.add_option("-R,--reservation", reservation, "Show jobs for a specific reservation");
+    app.add_flag("-n,--names", opts.jobname, "Show job names instead of job IDs");
+    app.add_flag("-N,--nodes", opts.nodes, "Show nodes allocated to running jobs");
+    app.add_flag("--stats", stats.enabled, "Print lookup statistics to stderr");
+    app.add_flag("--profile{text}", stats.profile, "Print a breakdown of where time was spent "
+        "to stderr, as text or json")->check(CLI::IsMember({"text", "json"}));
+    app.add_option("--threads", opts.threads, "Classify large queues with N threads "
+        "(default: one per core)")->check(CLI::PositiveNumber);
+    app.add_option("-w,--watch", watch, "Redraw the report whenever Slurm's data changes, "
+        "checking every N seconds")->check(CLI::PositiveNumber);
+    app.add_option("--snapshot", snapshot, "Read Slurm's tables from a snapshot file instead of slurmctld")
+        ->check(CLI::ExistingFile);
+    app.add_option("--dump-snapshot", dump_snapshot, "Write a snapshot of Slurm's tables to a file and exit");
+    app.add_flag("--daemon", daemon, "Run as showqd, polling Slurm and serving its tables to showq "
+        "clients on --socket");
+    app.add_flag("--allow-private-data", allow_private, "Run showqd even though Slurm's PrivateData "
+        "hides jobs, letting every client see all the jobs showqd can");
+    app.add_option("--interval", interval, "Seconds between showqd's polls of Slurm", true)
+        ->check(CLI::PositiveNumber);
+    app.add_option("--socket", socket, "Unix socket showqd listens on, and which showq asks before "
+        "querying Slurm itself; empty to always query Slurm", true);
+    app.add_option("--shm", shm, "Shared memory file showqd publishes to, and which showq reports "
+        "from before trying --socket; empty to skip it", true);
+    CLI::Option *format = app.add_option("-F,--format", opts.format, "Print each section's columns from a spec of "
+        "%[-][width][.max]field[{title}], with fields: " + Layout::field_names())
+        ->check([](const std::string& spec) {
+            Layout layout;
+            std::string error;
+            return layout.compile(spec, error) ? std::string() : error;
+        });
+    app.add_option("--output", output, "Print each section's jobs as text, or as json, csv, or "
+        "ndjson records with every field in full", true)
+        ->check(CLI::IsMember({"text", "json", "csv", "ndjson"}))->excludes(format);
+    app.add_flag("--expand-arrays", opts.expand_arrays, "List each job array task on its own line "
+        "rather than one line per array");
+    app.add_option("-l,--limit", opts.limit, "Show at most N jobs in each section; totals still "
+        "count every job")->check(CLI::PositiveNumber);
+    app.add_option("-o,--orderby", orderby, "Sort each section's jobs by comma-separated keys, "
+        "most significant first: " + sort_key_names() + "; or with --by, its rows by totals: "
+        + aggregate_key_names());
+    app.add_option("--by", by, "Total active, eligible, and blocked jobs, cores, nodes, and "
+        "remaining core-hours by one of: " + group_key_names())
+        ->check([](const std::string& name) {
+            GroupKey key;
+            std::string error;
+            return parse_group_key(name, key, error) ? std::string() : error;
+        });
+    app.add_option("-u,--username", username, "Show jobs for specific users (names or UIDs)");
+    app.add_option("-g,--group", groupname, "Show jobs for specific groups (names or GIDs)");
+    app.add_option("-a,--account", account, "Show jobs for specific accounts")->check(patterns);
+    app.add_option("-p,--partition", partition, "Show jobs for specific partitions, including "
+        "jobs submitted to several")->check(patterns);
+    app.add_option("-q,--qos", qosname, "Show jobs for specific QoSes")->check(patterns);
+    app.add_option("-R,--reservation", reservation, "Show jobs for specific reservations")
+        ->check(patterns);
+    app.add_option("--reason", reasons, "Show jobs waiting for specific comma-separated reasons, "
+        "as squeue names them")->check(reason_list);
+    app.add_option("--blocked-reasons", blocked_reasons, "Comma-separated reasons which block pending "
+        "jobs, replacing the defaults, or adding to or removing from them with + or -")
+        ->check(reason_list);
+    app.add_option("--config", config, "Site config file setting blocked_reasons", true);
     CLI11_PARSE(app, argc, argv);
+    if (stats.profile != "") Profiler::instance().enable();
     
-    // Load partition, node, and job information
-    slurm_init((char *) nullptr);
-    partition_info_msg_t *part_buffer_ptr = nullptr;
-    node_info_msg_t *node_buffer_ptr = nullptr;
-    job_info_msg_t *job_buffer_ptr = nullptr;
-    if(slurm_load_partitions( (std::time_t) nullptr, &part_buffer_ptr, SHOW_ALL)
-            || slurm_load_node( (std::time_t) nullptr, &node_buffer_ptr, SHOW_ALL)
-            || slurm_load_jobs( (std::time_t) nullptr, &job_buffer_ptr, SHOW_ALL) ) {
-        std::cerr << "Unable to query Slurm information" << std::endl;
-        return 3;
-    }
-    
-    // Filter and sort the jobs
-    std::vector<job_info_t *> jobs_running, jobs_idle, jobs_blocked, jobs_complete;
-    hostlist_t running_nodes = slurm_hostlist_create("");
-    for (unsigned i = 0; i < job_buffer_ptr->record_count; i++) {
-        job_info_t * job_ptr = &job_buffer_ptr->job_array[i];
-        
-        // If a filter is defined and doesn't hit, skip this job 
-        if (username != "" && username != uid2name(job_ptr->user_id)) continue;
-        if (groupname != "" && groupname != gid2name(job_ptr->group_id)) continue;
-        if (account != "" && account != std::string(job_ptr->account)) continue;
-        if (qosname != "" && qosname != std::string(job_ptr->qos)) continue;
-        
-        if (partition != "" && std::string(job_ptr->partition).find(partition) == std::string::npos) {
-            continue;
-        }
-        
-        if (reservation != "" && std::string(job_ptr->resv_name).find(reservation) == std::string::npos) {
-            continue;
+    // Which keys -o takes depends on --by, so they're only checked once both are known
+    std::string error;
+    if (by != "") {
+        parse_group_key(by, opts.by, error);
+        if (!parse_aggregate_keys(orderby, opts.by_order, error)) {
+            std::cerr << "--orderby: " << error << std::endl;
+            return 2;
         }
+    } else if (!parse_sort_keys(orderby, opts.orderby, error)) {
+        std::cerr << "--orderby: " << error << std::endl;
+        return 2;
+    }
+    if (!load_config(config, opts.blocked_reasons, error)) {
+        std::cerr << error << std::endl;
+        return 2;
+    }
+    parse_reasons(blocked_reasons, opts.blocked_reasons, error);
+    parse_reasons(reasons, opts.reasons, error);
+    opts.account.compile(account, error);
+    opts.partition.compile(partition, error);
+    opts.qos.compile(qosname, error);
+    opts.reservation.compile(reservation, error);
+    opts.output = output == "json" ? OUTPUT_JSON
+        : output == "csv" ? OUTPUT_CSV
+        : output == "ndjson" ? OUTPUT_NDJSON
+        : OUTPUT_TEXT;
+    opts.report = by != "" ? REPORT_GROUPED
+        : summary ? REPORT_SUMMARY
+        : completed ? REPORT_COMPLETED
+        : running ? REPORT_RUNNING
+        : idle ? REPORT_IDLE
+        : blocking ? REPORT_BLOCKED
+        : REPORT_DEFAULT;
 
-        // Sort jobs into running, idle, blocked, and completed
-        if (job_ptr->job_state == JOB_RUNNING) {
-            jobs_running.push_back(job_ptr);
-            slurm_hostlist_push(running_nodes, job_ptr->nodes);
-        } else if (job_ptr->job_state == JOB_PENDING) {
-            if (job_ptr->state_reason == WAIT_DEPENDENCY
-                    || job_ptr->state_reason == WAIT_HELD
-                    || job_ptr->state_reason == WAIT_TIME           
-                    || job_ptr->state_reason == WAIT_ASSOC_JOB_LIMIT          
-                    || job_ptr->state_reason == WAIT_QOS_MAX_CPU_PER_JOB
-                    || job_ptr->state_reason == WAIT_QOS_MAX_CPU_MINS_PER_JOB 
-                    || job_ptr->state_reason == WAIT_QOS_MAX_NODE_PER_JOB
-                    || job_ptr->state_reason == WAIT_QOS_MAX_WALL_PER_JOB
-                    || job_ptr->state_reason == WAIT_HELD_USER) {
-                jobs_blocked.push_back(job_ptr);
-            } else {
-                jobs_idle.push_back(job_ptr);
-            }
-        } else {
-            jobs_complete.push_back(job_ptr);
+    // Resolve user and group filters to numeric IDs once, rather than each job's IDs to names
+    {
+        ScopedTimer timer("resolve");
+        std::string unknown;
+        auto user_id = [](const std::string& name, uint32_t& id) {
+            uid_t uid;
+            if (!IdentityCache::instance().user_id(name, uid)) return false;
+            id = uid;
+            return true;
+        };
+        if (!opts.users.compile(username, user_id, unknown)) {
+            std::cerr << "Unknown user: " << unknown << std::endl;
+            return 2;
         }
-    }
-    
-    // Collect nodes in the relevant partition(s) for utilization stats
-    hostlist_t partition_nodes = slurm_hostlist_create("");
-    for (unsigned i = 0; i < part_buffer_ptr->record_count; i++) {
-        partition_info_t *part_ptr = &part_buffer_ptr->partition_array[i];
-        if (partition != "" && std::string(part_ptr->name).find(partition) == std::string::npos) {
-            continue;
+        auto group_id = [](const std::string& name, uint32_t& id) {
+            gid_t gid;
+            if (!IdentityCache::instance().group_id(name, gid)) return false;
+            id = gid;
+            return true;
+        };
+        if (!opts.groups.compile(groupname, group_id, unknown)) {
+            std::cerr << "Unknown group: " << unknown << std::endl;
+            return 2;
         }
-        slurm_hostlist_push(partition_nodes, part_ptr->nodes);
     }
-    
-    // Filter duplicate entries and get the final counts
-    slurm_hostlist_uniq(running_nodes);
-    slurm_hostlist_uniq(partition_nodes);
-    int running_nodes_count = slurm_hostlist_count(running_nodes);
-    int partition_nodes_count = slurm_hostlist_count(partition_nodes);
 
-    // Sort running jobs if an orderby directive was specified
-    if (orderby != "") {
-        std::transform(orderby.begin(), orderby.end(), orderby.begin(), toupper);
-        if (orderby == "REMAINING") {
-            std::stable_sort(jobs_running.begin(), jobs_running.end(), 
-                [](job_info_t *i, job_info_t *j){ return i->end_time < j->end_time; });
-        } else if (orderby == "REVERSEREMAINING") {
-            std::stable_sort(jobs_running.begin(), jobs_running.end(), 
-                [](job_info_t *i, job_info_t *j){ return i->end_time > j->end_time; });
-        } else if (orderby == "JOB") {
-            std::stable_sort(jobs_running.begin(), jobs_running.end(), 
-                [](job_info_t *i, job_info_t *j){ return i->job_id < j->job_id; });
-        } else if (orderby == "USER") {
-            std::stable_sort(jobs_running.begin(), jobs_running.end(), 
-                [](job_info_t *i, job_info_t *j){ return i->user_id < j->user_id; });
-        } else if (orderby == "STARTTIME") {
-            std::stable_sort(jobs_running.begin(), jobs_running.end(), 
-                [](job_info_t *i, job_info_t *j){ return i->start_time < j->start_time; });
+    if (dump_snapshot != "") {
+        SlurmJobSource source;
+        if (!write_snapshot(dump_snapshot, source)) {
+            std::cerr << "Unable to write snapshot " << dump_snapshot << std::endl;
+            return 3;
         }
+        return 0;
     }
 
-    // Print the requested report
-    if (summary) {
-        std::cout << "\nactive jobs: " << jobs_running.size() << "  eligible jobs: " 
-            << jobs_idle.size() << "  blocked jobs: " << jobs_blocked.size() << "\n\nTotal jobs: "
-            << jobs_running.size() + jobs_idle.size() + jobs_blocked.size() << "\n\n";
-        return 0;
+    if (daemon) {
+        SlurmJobSource source;
+        serve_snapshots(socket, shm, interval, allow_private, source);
+        return 3;
     }
-    
-    if (completed) {
-        printf("\ncompleted jobs---------------------\n");
-        printf("%-19s %-10s %-6s %3s %7s %2s %9s %9s %16s %5s %11s  %21s\n\n", 
-            "JOBID", "STATUS", "CCODE", "PAR", "XFACTOR", "Q", "USERNAME", "GROUP", 
-            "MHOST", "PROCS", "WALLTIME", "COMPLETIONTIME"
-        );
-        for (job_info_t* ji : jobs_complete) {
-            printf("%-19s %-10s %-6u %3s %7.1f %2s %9s %9s %16s %5u %11s  %21s\n", 
-                jobid_or_name(ji, jobname).substr(0,19).c_str(),
-                state2cstr(ji->job_state), 
-                ji->exit_code, 
-                std::string(ji->partition).substr(0,3).c_str(), 
-                calc_xfactor(ji),
-                std::string(ji->qos).substr(0,2).c_str(), 
-                uid2name(ji->user_id).c_str(), 
-                gid2name(ji->group_id).c_str(), 
-                ji->batch_host,
-                ji->num_tasks,
-                duration2str(std::difftime(ji->end_time, ji->start_time)).c_str(),
-                timestamp2str(ji->end_time).c_str()
-            );
-            if (nodes) printf("    Nodes: %s\n", ji->nodes);
-        }
-        std::cout << '\n' << jobs_complete.size() << " completed jobs\n\nTotal jobs: " 
-            << jobs_complete.size() << "\n\n";
-        return 0;
-    } 
-    
-    if (running) {
-        printf("\nactive jobs------------------------\n");
-        printf("%-19s %-10s %3s %7s %2s %9s %9s %16s %5s %11s  %21s\n\n", 
-            "JOBID", "STATUS", "PAR", "XFACTOR", "Q", "USERNAME", "GROUP", 
-            "MHOST", "PROCS", "REMAINING", "STARTTIME"
-        );
-        for (job_info_t* ji : jobs_running) {
-            printf("%-19s %-10s %3s %7.1f %2s %9s %9s %16s %5u %11s  %21s\n", 
-                jobid_or_name(ji, jobname).substr(0,19).c_str(),
-                state2cstr(ji->job_state),
-                std::string(ji->partition).substr(0,3).c_str(), 
-                calc_xfactor(ji),
-                std::string(ji->qos).substr(0,2).c_str(), 
-                uid2name(ji->user_id).c_str(), 
-                gid2name(ji->group_id).c_str(), 
-                ji->batch_host,
-                ji->num_tasks,
-                duration2str(std::difftime(ji->end_time, std::time(nullptr))).c_str(),
-                timestamp2str(ji->start_time).c_str()
-            );
-            if (nodes) printf("    Nodes: %s\n", ji->nodes);
-        }
-        std::cout << '\n' << jobs_running.size() << " active jobs\t\t" << running_nodes_count
-            << " of " << partition_nodes_count << " nodes active      (" << std::setprecision(2)
-            << static_cast<double>(running_nodes_count) / partition_nodes_count * 100 << "%)"
-            << "\n\nTotal jobs: " << jobs_running.size() << "\n\n";
-        return 0;
-    } 
-    
-    if (idle) {
-        printf("\neligible jobs----------------------\n");
-        printf("%-19s %10s %3s %7s %2s %9s %9s %5s %11s  %21s\n\n", 
-            "JOBID", "PRIORITY", "PAR", "XFACTOR", "Q", "USERNAME", "GROUP", 
-            "PROCS", "WCLIMIT", "SYSTEMQUEUETIME"
-        );
-        for (job_info_t* ji : jobs_idle) {
-            printf("%-19s %10u %3s %7.1f %2s %9s %9s %5u %11s  %21s\n", 
-                jobid_or_name(ji, jobname).substr(0,19).c_str(),
-                ji->priority,  
-                std::string(ji->partition).substr(0,3).c_str(), 
-                calc_xfactor(ji),
-                std::string(ji->qos).substr(0,2).c_str(), 
-                uid2name(ji->user_id).c_str(), 
-                gid2name(ji->group_id).c_str(), 
-                ji->num_tasks,
-                duration2str(ji->time_limit * 60).c_str(),
-                timestamp2str(ji->submit_time).c_str()
-            );
-        }
-        std::cout << '\n' << jobs_idle.size() << " eligible jobs\n\nTotal jobs: " 
-            << jobs_idle.size() << "\n\n";
-        return 0;
 
-    } 
-    
-    if (blocking) {
-        printf("\nblocked jobs-----------------------\n");
-        printf("%-18s %8s %8s %10s %5s %11s  %21s\n\n",
-            "JOBID", "USERNAME", "GROUP", "STATE", "PROCS", "WCLIMIT", "QUEUETIME"
-        );
-        for (job_info_t *ji : jobs_blocked) {
-            printf("%-18s %8s %8s %10s %5u %11s  %21s\n",
-                jobid_or_name(ji, jobname).substr(0,18).c_str(),
-                uid2name(ji->user_id).c_str(),
-                gid2name(ji->group_id).c_str(),
-                state2cstr(ji->job_state),
-                ji->num_tasks,
-                duration2str(ji->time_limit * 60).c_str(),
-                timestamp2str(ji->submit_time).c_str()
-            );
-        }
-        std::cout << '\n' << jobs_blocked.size() << " blocked jobs\n\nTotal jobs: " 
-            << jobs_blocked.size() << "\n\n";
-        return 0;
+    std::unique_ptr<JobSource> source;
+    if (snapshot != "") {
+        source.reset(new SnapshotJobSource(snapshot));
+        if (!source->load(report_tables(opts.report))) source.reset();
+    } else {
+        source = load_source(opts, shm, socket);
     }
-    
-    printf("\nactive jobs------------------------\n");
-    printf("%-18s %8s %10s %5s %11s  %21s\n\n", 
-        "JOBID", "USERNAME", "STATE", "PROCS", "REMAINING", "STARTTIME"
-    ); 
-    for (job_info_t *ji : jobs_running) {
-        printf("%-18s %8s %10s %5u %11s  %21s\n", 
-            jobid_or_name(ji, jobname).substr(0,18).c_str(),
-            uid2name(ji->user_id).c_str(),
-            state2cstr(ji->job_state),
-            ji->num_tasks,
-            duration2str(std::difftime(ji->end_time, std::time(nullptr))).c_str(),
-            timestamp2str(ji->start_time).c_str()
-        );
-        if (nodes) printf("    Nodes: %s\n", ji->nodes);
+    if (!source) {
+        std::cerr << "Unable to query Slurm information" << std::endl;
+        return 3;
     }
-    std::cout << '\n' << jobs_running.size() << " active jobs\t\t" << running_nodes_count
-            << " of " << partition_nodes_count << " nodes active      (" << std::setprecision(2)
-            << static_cast<double>(running_nodes_count) / partition_nodes_count * 100 << "%)";
 
-    printf("\n\neligible jobs----------------------\n");
-    printf("%-18s %8s %10s %5s %11s  %21s\n\n", 
-        "JOBID", "USERNAME", "STATE", "PROCS", "WCLIMIT", "QUEUETIME"
-    ); 
-    for (job_info_t *ji : jobs_idle) {
-        printf("%-18s %8s %10s %5u %11s  %21s\n", 
-            jobid_or_name(ji, jobname).substr(0,18).c_str(),
-            uid2name(ji->user_id).c_str(),
-            state2cstr(ji->job_state),
-            ji->num_tasks,
-            duration2str(ji->time_limit * 60).c_str(),
-            timestamp2str(ji->submit_time).c_str()
-        );
+    if (!watch) {
+        print_report(opts, *source);
+        return 0;
     }
-    std::cout << '\n' << jobs_idle.size() << " eligible jobs";
 
-    printf("\n\nblocked jobs-----------------------\n");
-    printf("%-18s %8s %10s %5s %11s  %21s\n\n", 
-        "JOBID", "USERNAME", "STATE", "PROCS", "WCLIMIT", "QUEUETIME"
-    ); 
-    for (job_info_t *ji : jobs_blocked) {
-        printf("%-18s %8s %10s %5u %11s  %21s\n", 
-            jobid_or_name(ji, jobname).substr(0,18).c_str(),
-            uid2name(ji->user_id).c_str(),
-            state2cstr(ji->job_state),
-            ji->num_tasks,
-            duration2str(ji->time_limit * 60).c_str(),
-            timestamp2str(ji->submit_time).c_str()
-        );
+    // Finish normally when interrupted, so the statistics and profile are still printed. The
+    // handlers don't restart sleep, so the loop notices straight away.
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    // Poll for changes, handing Slurm the time of our last snapshot so unchanged tables
+    // aren't resent, and only redraw when something actually changed
+    bool changed = true;
+    while (!stopping) {
+        if (changed) {
+            std::cout << "\033[H\033[2J" << std::flush;
+            print_report(opts, *source);
+            std::cout << std::flush;
+            fflush(stdout);
+        }
+        sleep(watch);
+        if (stopping) break;
+        if (source->refresh(report_tables(opts.report), changed)) continue;
+
+        // showqd has stopped or gone stale, or Slurm didn't answer: start again from showqd,
+        // as a restarted one may be back, then Slurm itself
+        std::unique_ptr<JobSource> reloaded;
+        if (snapshot == "") reloaded = load_source(opts, shm, socket);
+        if (reloaded) {
+            source = std::move(reloaded);
+            changed = true;
+        } else {
+            std::cerr << "Unable to query Slurm information" << std::endl;
+        }
     }
-    std::cout << '\n' << jobs_blocked.size() << " blocked jobs\n\nTotal jobs: " 
-        << jobs_blocked.size() + jobs_idle.size() + jobs_running.size() << "\n\n";
-    
     return 0;
 }
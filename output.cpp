@@ -0,0 +1,111 @@
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+#include "output.hpp"
+
+
+// Format an unsigned integer right-aligned into the end of buf, returning where it starts
+static char* format_uint(unsigned long value, char *end) {
+    char *p = end;
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    return p;
+}
+
+
+OutputBuffer::OutputBuffer(int fd, size_t flush_at) : fd_(fd), flush_at_(flush_at) {
+    buf_.reserve(flush_at + (flush_at >> 2));
+}
+
+
+OutputBuffer& OutputBuffer::num(unsigned long value) {
+    char digits[24];
+    char *start = format_uint(value, digits + sizeof(digits));
+    return str(start, digits + sizeof(digits) - start);
+}
+
+
+OutputBuffer& OutputBuffer::signed_num(long value) {
+    char digits[24];
+    char *start = format_uint(value < 0 ? 0 - static_cast<unsigned long>(value) : value,
+        digits + sizeof(digits));
+    if (value < 0) *--start = '-';
+    return str(start, digits + sizeof(digits) - start);
+}
+
+
+OutputBuffer& OutputBuffer::pad(const char *s, size_t len, size_t width, bool left) {
+    if (!left && len < width) buf_.append(width - len, ' ');
+    buf_.append(s, len);
+    if (left && len < width) buf_.append(width - len, ' ');
+    if (buf_.size() > flush_at_) flush();
+    return *this;
+}
+
+
+OutputBuffer& OutputBuffer::left(const char *s, size_t width, size_t max) {
+    return pad(s, strnlen(s, max), width, true);
+}
+
+
+OutputBuffer& OutputBuffer::right(const char *s, size_t width, size_t max) {
+    return pad(s, strnlen(s, max), width, false);
+}
+
+
+OutputBuffer& OutputBuffer::left(unsigned long value, size_t width) {
+    char digits[24];
+    char *start = format_uint(value, digits + sizeof(digits));
+    return pad(start, digits + sizeof(digits) - start, width, true);
+}
+
+
+OutputBuffer& OutputBuffer::right(unsigned long value, size_t width) {
+    char digits[24];
+    char *start = format_uint(value, digits + sizeof(digits));
+    return pad(start, digits + sizeof(digits) - start, width, false);
+}
+
+
+OutputBuffer& OutputBuffer::fixed1(double value, size_t width, bool left) {
+    // Room for the longest %.1f of a double: a sign, DBL_MAX's 309 digits, ".0", and a NUL
+    char digits[DBL_MAX_10_EXP + 5];
+    char *end = digits + sizeof(digits), *start;
+
+    // Scaling by ten is exact in long double, so rounding it to nearest-even matches printf
+    long double tenths = std::nearbyint(static_cast<long double>(value) * 10);
+    if (!std::isfinite(value) || std::fabs(tenths) > 1e18L) {
+        int len = std::snprintf(digits, sizeof(digits), "%.1f", value);
+        return pad(digits, len, width, left);
+    }
+
+    bool negative = std::signbit(value);
+    unsigned long long magnitude = std::fabs(tenths);
+    start = format_uint(magnitude / 10, end - 2);
+    end[-2] = '.';
+    end[-1] = '0' + magnitude % 10;
+    if (negative) *--start = '-';
+    return pad(start, end - start, width, left);
+}
+
+
+bool OutputBuffer::flush() {
+    const char *p = buf_.data();
+    size_t left = buf_.size();
+    while (left) {
+        ssize_t written = write(fd_, p, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            buf_.clear();
+            return false;
+        }
+        p += written;
+        left -= written;
+    }
+    buf_.clear();
+    return true;
+}
@@ -0,0 +1,66 @@
+#include <iomanip>
+
+#include "identity.hpp"
+#include "profile.hpp"
+
+
+void Profiler::add(const char *name, double ns, unsigned long records, unsigned long lookups) {
+    auto it = phases_.begin();
+    while (it != phases_.end() && it->name != name) ++it;
+    if (it == phases_.end()) {
+        phases_.emplace_back();
+        it = phases_.end() - 1;
+        it->name = name;
+    }
+    it->calls++;
+    it->ns += ns;
+    it->records += records;
+    it->lookups += lookups;
+}
+
+
+void Profiler::print_text(std::ostream& os) const {
+    double total = 0;
+    os << std::left << std::setw(20) << "PHASE" << std::right << std::setw(8) << "CALLS"
+        << std::setw(12) << "TIME(ms)" << std::setw(12) << "RECORDS" << std::setw(10) << "LOOKUPS"
+        << '\n';
+    os << std::fixed << std::setprecision(3);
+    for (const Phase& p : phases_) {
+        os << std::left << std::setw(20) << p.name << std::right << std::setw(8) << p.calls
+            << std::setw(12) << p.ns / 1e6 << std::setw(12) << p.records << std::setw(10)
+            << p.lookups << '\n';
+        total += p.ns;
+    }
+    os << std::left << std::setw(28) << "total" << std::right << std::setw(12) << total / 1e6
+        << '\n';
+}
+
+
+void Profiler::print_json(std::ostream& os) const {
+    double total = 0;
+    os << std::fixed << std::setprecision(3) << "{\"phases\":[";
+    for (size_t i = 0; i < phases_.size(); i++) {
+        const Phase& p = phases_[i];
+        os << (i ? "," : "") << "{\"name\":\"" << p.name << "\",\"calls\":" << p.calls
+            << ",\"ms\":" << p.ns / 1e6 << ",\"records\":" << p.records << ",\"lookups\":"
+            << p.lookups << '}';
+        total += p.ns;
+    }
+    os << "],\"total_ms\":" << total / 1e6 << "}\n";
+}
+
+
+ScopedTimer::ScopedTimer(const char *phase)
+        : phase_(phase), enabled_(Profiler::instance().enabled()) {
+    if (!enabled_) return;
+    lookups_ = IdentityCache::instance().lookups();
+    start_ = std::chrono::steady_clock::now();
+}
+
+
+ScopedTimer::~ScopedTimer() {
+    if (!enabled_) return;
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    Profiler::instance().add(phase_, std::chrono::duration<double, std::nano>(elapsed).count(),
+        records_, IdentityCache::instance().lookups() - lookups_);
+}
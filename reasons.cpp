@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include "slurm/slurm.h"
+
+#include "reasons.hpp"
+
+
+// Pending jobs waiting on one of these reasons are blocked rather than eligible to run
+static const uint32_t BLOCKED_REASONS[] = {
+    WAIT_DEPENDENCY,
+    WAIT_HELD,
+    WAIT_TIME,
+    WAIT_ASSOC_JOB_LIMIT,
+    WAIT_QOS_MAX_CPU_PER_JOB,
+    WAIT_QOS_MAX_CPU_MINS_PER_JOB,
+    WAIT_QOS_MAX_NODE_PER_JOB,
+    WAIT_QOS_MAX_WALL_PER_JOB,
+    WAIT_HELD_USER,
+};
+
+
+void ReasonSet::add(uint32_t reason) {
+    if (reason >= reasons_.size()) reasons_.resize(reason + 1);
+    if (!reasons_[reason]) count_++;
+    reasons_[reason] = 1;
+}
+
+
+void ReasonSet::remove(uint32_t reason) {
+    if (!contains(reason)) return;
+    reasons_[reason] = 0;
+    count_--;
+}
+
+
+void ReasonSet::clear() {
+    reasons_.clear();
+    count_ = 0;
+}
+
+
+ReasonSet default_blocked_reasons() {
+    ReasonSet reasons;
+    for (uint32_t reason : BLOCKED_REASONS) reasons.add(reason);
+    return reasons;
+}
+
+
+static std::string lowercase(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), tolower);
+    return s;
+}
+
+
+// Slurm's names for its reasons, in lower case
+static const std::unordered_map<std::string, uint32_t>& reason_numbers() {
+    static const std::unordered_map<std::string, uint32_t> numbers = [] {
+        std::unordered_map<std::string, uint32_t> numbers;
+        for (uint32_t reason = 0; reason < REASON_END; reason++) {
+            const char *name = slurm_job_reason_string(static_cast<job_state_reason>(reason));
+            if (name && *name && *name != '?') numbers.emplace(lowercase(name), reason);
+        }
+        return numbers;
+    }();
+    return numbers;
+}
+
+
+static bool parse_reason(const std::string& name, uint32_t& reason) {
+    if (!name.empty() && std::all_of(name.begin(), name.end(), isdigit)) {
+        unsigned long number = std::strtoul(name.c_str(), nullptr, 10);
+        reason = number;
+        return number < REASON_END;
+    }
+    auto found = reason_numbers().find(lowercase(name));
+    if (found == reason_numbers().end()) return false;
+    reason = found->second;
+    return true;
+}
+
+
+static std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+
+bool parse_reasons(const std::string& spec, ReasonSet& reasons, std::string& error) {
+    ReasonSet result = reasons;
+    bool replaced = false;
+    std::istringstream items(spec);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        item = trim(item);
+        char op = item.empty() ? 0 : item[0];
+        std::string name = op == '+' || op == '-' ? trim(item.substr(1)) : item;
+        uint32_t reason;
+        if (!parse_reason(name, reason)) {
+            error = "Unknown reason: " + name;
+            return false;
+        }
+        if (op == '-') {
+            result.remove(reason);
+        } else if (op == '+') {
+            result.add(reason);
+        } else {
+            if (!replaced) result.clear();
+            replaced = true;
+            result.add(reason);
+        }
+    }
+    reasons = result;
+    return true;
+}
+
+
+bool load_config(const std::string& path, ReasonSet& blocked, std::string& error) {
+    std::ifstream file(path);
+    if (!file) return true;
+    std::string line;
+    for (unsigned number = 1; std::getline(file, line); number++) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        size_t equals = line.find('=');
+        std::string key = trim(line.substr(0, equals));
+        std::string where = path + ":" + std::to_string(number) + ": ";
+        if (equals == std::string::npos || key != "blocked_reasons") {
+            error = where + "Unknown setting: " + line;
+            return false;
+        }
+        if (!parse_reasons(trim(line.substr(equals + 1)), blocked, error)) {
+            error = where + error;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,184 @@
+#include <cstring>
+
+#include "slurm/slurm.h"
+
+#include "identity.hpp"
+#include "layout.hpp"
+#include "record_writer.hpp"
+
+
+RecordWriter::RecordWriter(OutputBuffer& out, OutputFormat format,
+        const std::vector<const char *>& fields) : out_(out), format_(format) {
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (format_ == OUTPUT_CSV) {
+            out_.str(i ? "," : "").str(fields[i]);
+        } else {
+            keys_.push_back(std::string(i ? ",\"" : "{\"") + fields[i] + "\":");
+        }
+    }
+    if (format_ == OUTPUT_CSV) out_.chr('\n');
+    if (format_ == OUTPUT_JSON) out_.chr('[');
+}
+
+
+void RecordWriter::begin_record() {
+    if (format_ == OUTPUT_JSON) out_.str(records_ ? ",\n" : "\n");
+    records_++;
+    field_ = 0;
+}
+
+
+void RecordWriter::end_record() {
+    if (format_ == OUTPUT_CSV) {
+        out_.chr('\n');
+    } else {
+        out_.chr('}');
+        if (format_ == OUTPUT_NDJSON) out_.chr('\n');
+    }
+}
+
+
+void RecordWriter::finish() {
+    if (format_ == OUTPUT_JSON) out_.str(records_ ? "\n]\n" : "]\n");
+}
+
+
+void RecordWriter::next_field() {
+    if (format_ != OUTPUT_CSV) {
+        out_.str(keys_[field_]);
+    } else if (field_) {
+        out_.chr(',');
+    }
+    field_++;
+}
+
+
+RecordWriter& RecordWriter::value(unsigned long n) {
+    next_field();
+    out_.num(n);
+    return *this;
+}
+
+
+RecordWriter& RecordWriter::signed_value(long n) {
+    next_field();
+    out_.signed_num(n);
+    return *this;
+}
+
+
+RecordWriter& RecordWriter::value(const char *s) {
+    next_field();
+    if (!s) {
+        if (format_ != OUTPUT_CSV) out_.str("null");
+    } else if (format_ == OUTPUT_CSV) {
+        csv_string(s);
+    } else {
+        json_string(s);
+    }
+    return *this;
+}
+
+
+RecordWriter& RecordWriter::slurm_value(uint32_t n) {
+    if (n == NO_VAL || n == INFINITE) return value(static_cast<const char *>(nullptr));
+    return value(static_cast<unsigned long>(n));
+}
+
+
+RecordWriter& RecordWriter::fixed_value(double n) {
+    next_field();
+    out_.fixed1(n, 0);
+    return *this;
+}
+
+
+// Copy runs of characters which need no escaping as they are
+void RecordWriter::json_string(const char *s) {
+    static const char HEX[] = "0123456789abcdef";
+    out_.chr('"');
+    const char *run = s, *p = s;
+    for (; *p; p++) {
+        unsigned char c = *p;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out_.str(run, p - run);
+        switch (c) {
+            case '"': out_.str("\\\""); break;
+            case '\\': out_.str("\\\\"); break;
+            case '\n': out_.str("\\n"); break;
+            case '\r': out_.str("\\r"); break;
+            case '\t': out_.str("\\t"); break;
+            default: out_.str("\\u00").chr(HEX[c >> 4]).chr(HEX[c & 0xf]);
+        }
+        run = p + 1;
+    }
+    out_.str(run, p - run).chr('"');
+}
+
+
+// Fields are only quoted if they hold a separator, quote, or line break, with quotes doubled
+void RecordWriter::csv_string(const char *s) {
+    const char *special = std::strpbrk(s, ",\"\r\n");
+    if (!special) {
+        out_.str(s);
+        return;
+    }
+    out_.chr('"');
+    for (const char *run = s; ; ) {
+        const char *quote = std::strchr(run, '"');
+        if (!quote) {
+            out_.str(run);
+            break;
+        }
+        out_.str(run, quote - run + 1).chr('"');
+        run = quote + 1;
+    }
+    out_.chr('"');
+}
+
+
+const std::vector<const char *>& job_record_fields() {
+    static const std::vector<const char *> fields = {
+        "section", "job_id", "array_job_id", "array_task_id", "array_tasks", "tasks", "name",
+        "user", "user_id", "group", "group_id", "state", "state_reason", "exit_code", "partition", "account", "qos",
+        "reservation", "priority", "num_tasks", "num_cpus", "num_nodes", "nodes", "batch_host",
+        "time_limit", "submit_time", "eligible_time", "start_time", "end_time",
+    };
+    return fields;
+}
+
+
+void write_job(RecordWriter& writer, const char *section, const JobTable& jobs, uint32_t row,
+        const ArrayTasks *array) {
+    writer.begin_record();
+    writer.value(section)
+        .value(jobs.job_id[row])
+        .value(jobs.array_job_id[row])
+        .slurm_value(jobs.array_task_id[row])
+        .value(array ? array->tasks.c_str() : nullptr)
+        .value(array ? array->count : 1)
+        .value(jobs.name[row])
+        .value(uid2name(jobs.user_id[row]).c_str())
+        .value(jobs.user_id[row])
+        .value(gid2name(jobs.group_id[row]).c_str())
+        .value(jobs.group_id[row])
+        .value(state2cstr(jobs.job_state[row]))
+        .value(jobs.state_reason[row])
+        .slurm_value(jobs.exit_code[row])
+        .value(jobs.partition[row])
+        .value(jobs.account[row])
+        .value(jobs.qos[row])
+        .value(jobs.resv_name[row])
+        .slurm_value(jobs.priority[row])
+        .slurm_value(jobs.num_tasks[row])
+        .slurm_value(jobs.num_cpus[row])
+        .slurm_value(jobs.num_nodes[row])
+        .value(jobs.nodes[row])
+        .value(jobs.batch_host[row])
+        .slurm_value(jobs.time_limit[row])
+        .signed_value(jobs.submit_time[row])
+        .signed_value(jobs.eligible_time[row])
+        .signed_value(jobs.start_time[row])
+        .signed_value(jobs.end_time[row]);
+    writer.end_record();
+}
@@ -0,0 +1,1006 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "identity.hpp"
+#include "layout.hpp"
+#include "output.hpp"
+#include "profile.hpp"
+#include "report.hpp"
+#include "sort.hpp"
+
+
+// Only the reports with a node utilization line need the partition table, and the summary and
+// grouped report only count jobs, so they can use Slurm's records without extracting them
+unsigned report_tables(Report report) {
+    switch (report) {
+        case REPORT_GROUPED:
+        case REPORT_SUMMARY:
+            return TABLE_JOB_RECORDS;
+        case REPORT_RUNNING:
+        case REPORT_DEFAULT:
+            return TABLE_JOBS | TABLE_PARTITIONS;
+        default:
+            return TABLE_JOBS;
+    }
+}
+
+
+// Sorts jobs into sections by their state and, for pending jobs, whether their reason is one
+// of the blocking ones
+class Categorizer {
+public:
+    explicit Categorizer(const ReasonSet& blocked) : blocked_(blocked) {}
+
+    Category operator()(uint32_t state, uint32_t reason) const {
+        if (state == JOB_RUNNING) return CATEGORY_RUNNING;
+        if (state != JOB_PENDING) return CATEGORY_COMPLETE;
+        return blocked_.contains(reason) ? CATEGORY_BLOCKED : CATEGORY_IDLE;
+    }
+
+private:
+    const ReasonSet& blocked_;
+};
+
+
+// What each section is called in record output
+static const char *SECTION_NAMES[CATEGORIES] = {"active", "eligible", "blocked", "completed"};
+
+
+// Below this many jobs per thread, starting threads costs more than it saves
+static const unsigned PARALLEL_CHUNK = 32768;
+
+
+// Which of a string column's distinct values pass a filter, evaluated once per value rather
+// than once per job. Null strings are matched as empty strings.
+template <typename Match>
+static std::vector<char> select_values(const StringColumn& column, Match match) {
+    const StringPool& pool = column.pool();
+    std::vector<char> selected(pool.size());
+    for (StringPool::Id id = 0; id < pool.size(); id++) {
+        const char *value = pool.get(id);
+        selected[id] = match(value ? value : "");
+    }
+    return selected;
+}
+
+
+// The string filters, resolved against the values present in the job table
+struct Selection {
+    std::vector<char> account, qos, partition, reservation;
+
+    Selection(const Options& opts, const JobTable& jobs) {
+        select(opts.account, jobs.account, account);
+        select(opts.qos, jobs.qos, qos);
+        if (!opts.partition.empty()) {
+            partition = select_values(jobs.partition, [&](const char *s) {
+                return opts.partition.matches_any(s);
+            });
+        }
+        select(opts.reservation, jobs.resv_name, reservation);
+    }
+
+    static void select(const StringFilter& filter, const StringColumn& column, std::vector<char>& values) {
+        if (filter.empty()) return;
+        values = select_values(column, [&](const char *s) { return filter.matches(s); });
+    }
+};
+
+
+static bool selected(const std::vector<char>& values, const StringColumn& column, uint32_t row) {
+    return values.empty() || values[column.id(row)];
+}
+
+
+// Whether a table row passes the filters
+static bool selected_row(const Options& opts, const Selection& selection, const JobTable& jobs,
+        uint32_t row) {
+    if (!opts.users.empty() && !opts.users.matches(jobs.user_id[row])) return false;
+    if (!opts.groups.empty() && !opts.groups.matches(jobs.group_id[row])) return false;
+    if (!selected(selection.account, jobs.account, row)) return false;
+    if (!selected(selection.qos, jobs.qos, row)) return false;
+    if (!selected(selection.partition, jobs.partition, row)) return false;
+    if (!selected(selection.reservation, jobs.resv_name, row)) return false;
+    return opts.reasons.empty() || opts.reasons.contains(jobs.state_reason[row]);
+}
+
+
+// Whether one of Slurm's job records passes the filters
+static bool selected_job(const Options& opts, const job_info_t& job) {
+    if (!opts.users.empty() && !opts.users.matches(job.user_id)) return false;
+    if (!opts.groups.empty() && !opts.groups.matches(job.group_id)) return false;
+    if (!opts.account.matches(job.account) || !opts.qos.matches(job.qos)) return false;
+    if (!opts.partition.matches_any(job.partition) || !opts.reservation.matches(job.resv_name)) {
+        return false;
+    }
+    return opts.reasons.empty() || opts.reasons.contains(job.state_reason);
+}
+
+
+static void classify_range(const Options& opts, const Selection& selection, const JobTable& jobs,
+        uint32_t begin, uint32_t end, JobBuckets& buckets) {
+    Categorizer categorize(opts.blocked_reasons);
+    std::vector<uint32_t> *sections[CATEGORIES] = {&buckets.running, &buckets.idle, &buckets.blocked,
+        &buckets.complete};
+    for (uint32_t row = begin; row < end; row++) {
+        // If a filter is defined and doesn't hit, skip this job 
+        if (!selected_row(opts, selection, jobs, row)) continue;
+
+        // Sort jobs into running, idle, blocked, and completed
+        sections[categorize(jobs.job_state[row], jobs.state_reason[row])]->push_back(row);
+    }
+}
+
+
+template <typename T>
+static void append(std::vector<T>& to, const std::vector<T>& from) {
+    to.insert(to.end(), from.begin(), from.end());
+}
+
+
+// Record how many jobs each section has before arrays are compacted, for the totals
+static void count_jobs(JobBuckets& buckets) {
+    buckets.running_jobs = buckets.running.size();
+    buckets.idle_jobs = buckets.idle.size();
+    buckets.blocked_jobs = buckets.blocked.size();
+    buckets.complete_jobs = buckets.complete.size();
+}
+
+
+void classify_jobs(const Options& opts, const JobTable& jobs, JobBuckets& buckets) {
+    buckets.table = &jobs;
+    Selection selection(opts, jobs);
+    unsigned threads = opts.threads ? opts.threads : std::thread::hardware_concurrency();
+    threads = std::max(1u, std::min(threads, jobs.size() / PARALLEL_CHUNK));
+    if (threads == 1) {
+        classify_range(opts, selection, jobs, 0, jobs.size(), buckets);
+        count_jobs(buckets);
+        return;
+    }
+
+    // Classify contiguous chunks of the job table into buckets of their own, then concatenate
+    // them in chunk order so the result matches a serial pass
+    std::vector<JobBuckets> chunks(threads);
+    std::vector<std::thread> workers;
+    uint32_t per_thread = (jobs.size() + threads - 1) / threads;
+    for (unsigned t = 0; t < threads; t++) {
+        uint32_t begin = std::min(t * per_thread, jobs.size());
+        uint32_t end = std::min(begin + per_thread, jobs.size());
+        workers.emplace_back(classify_range, std::cref(opts), std::cref(selection), std::cref(jobs),
+            begin, end, std::ref(chunks[t]));
+    }
+    for (std::thread& worker : workers) worker.join();
+    size_t running = 0, idle = 0, blocked = 0, complete = 0;
+    for (const JobBuckets& chunk : chunks) {
+        running += chunk.running.size();
+        idle += chunk.idle.size();
+        blocked += chunk.blocked.size();
+        complete += chunk.complete.size();
+    }
+    buckets.running.reserve(buckets.running.size() + running);
+    buckets.idle.reserve(buckets.idle.size() + idle);
+    buckets.blocked.reserve(buckets.blocked.size() + blocked);
+    buckets.complete.reserve(buckets.complete.size() + complete);
+    for (const JobBuckets& chunk : chunks) {
+        append(buckets.running, chunk.running);
+        append(buckets.idle, chunk.idle);
+        append(buckets.blocked, chunk.blocked);
+        append(buckets.complete, chunk.complete);
+    }
+    count_jobs(buckets);
+}
+
+
+void summarize_jobs(const Options& opts, const job_info_msg_t *records, Summary& summary) {
+    Categorizer categorize(opts.blocked_reasons);
+    for (unsigned i = 0; i < records->record_count; i++) {
+        const job_info_t& job = records->job_array[i];
+        if (!selected_job(opts, job)) continue;
+
+        Category cat = categorize(job.job_state, job.state_reason);
+        summary.jobs[cat]++;
+        summary.cores[cat] += job.num_cpus;
+        summary.nodes[cat] += job.num_nodes;
+    }
+}
+
+
+void summarize_jobs(const Options& opts, const JobTable& jobs, Summary& summary) {
+    Categorizer categorize(opts.blocked_reasons);
+    Selection selection(opts, jobs);
+    for (uint32_t row = 0; row < jobs.size(); row++) {
+        if (!selected_row(opts, selection, jobs, row)) continue;
+
+        Category cat = categorize(jobs.job_state[row], jobs.state_reason[row]);
+        summary.jobs[cat]++;
+        summary.cores[cat] += jobs.num_cpus[row];
+        summary.nodes[cat] += jobs.num_nodes[row];
+    }
+}
+
+
+static const char *GROUP_KEY_NAMES[] = {"user", "group", "account", "partition", "qos"};
+static const char *GROUP_PLURALS[] = {"users", "groups", "accounts", "partitions", "QoSes"};
+static const char *AGGREGATE_KEY_NAMES[] = {"KEY", "JOBS", "ACTIVE", "ELIGIBLE", "BLOCKED", "CORES",
+    "NODES", "COREHOURS"};
+
+
+bool parse_group_key(const std::string& name, GroupKey& key, std::string& error) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), tolower);
+    const char **match = std::find_if(std::begin(GROUP_KEY_NAMES), std::end(GROUP_KEY_NAMES),
+        [&](const char *key) { return lower == key; });
+    if (match == std::end(GROUP_KEY_NAMES)) {
+        error = "Unknown group key: " + name;
+        return false;
+    }
+    key = static_cast<GroupKey>(match - std::begin(GROUP_KEY_NAMES));
+    return true;
+}
+
+
+bool parse_aggregate_keys(const std::string& spec, std::vector<AggregateKey>& keys,
+        std::string& error) {
+    std::vector<size_t> indexes;
+    if (!parse_key_list(spec, std::begin(AGGREGATE_KEY_NAMES), std::end(AGGREGATE_KEY_NAMES), "total",
+            indexes, error)) {
+        return false;
+    }
+    keys.clear();
+    for (size_t index : indexes) keys.push_back(static_cast<AggregateKey>(index));
+    return true;
+}
+
+
+std::string group_key_names() {
+    return join_names(std::begin(GROUP_KEY_NAMES), std::end(GROUP_KEY_NAMES));
+}
+
+
+std::string aggregate_key_names() {
+    return join_names(std::begin(AGGREGATE_KEY_NAMES), std::end(AGGREGATE_KEY_NAMES));
+}
+
+
+// The grouped report's rows, each found with one hash lookup: user and group IDs through a
+// hash map, and strings through our own string pool's index, which is dense enough to index
+// rows directly. Strings from a table's column are only interned once, by their index in the
+// column's pool. Elements of lists are only given rows if they pass elements, so that a job
+// submitted to several partitions only counts in those selected.
+class AggregateRows {
+public:
+    explicit AggregateRows(const StringFilter& elements) : elements_(elements) {}
+
+    Aggregate& id(uint32_t id) {
+        auto found = ids_.emplace(id, rows_.size());
+        if (found.second) add_row(id);
+        return rows_[found.first->second];
+    }
+
+    // The row of a string from Slurm's records
+    Aggregate& name(const char *name) {
+        return rows_[name_row(name)];
+    }
+
+    // The rows of each element of a comma-separated list from Slurm's records, as with jobs
+    // submitted to several partitions
+    const std::vector<uint32_t>& names(const char *list) {
+        split_.clear();
+        split(list, split_);
+        return split_;
+    }
+
+    // The rows of a string from a table's column, by its index in the column's pool, with a
+    // row for each element if it is split as a list
+    const std::vector<uint32_t>& slot(StringPool::Id slot, const char *name, bool list) {
+        if (slot >= slots_.size()) slots_.resize(slot + 1);
+        std::vector<uint32_t>& rows = slots_[slot];
+        if (rows.empty()) {
+            if (list) {
+                split(name, rows);
+            } else {
+                rows.push_back(name_row(name));
+            }
+        }
+        return rows;
+    }
+
+    Aggregate& operator[](uint32_t row) { return rows_[row]; }
+
+    // Move the rows out, naming those keyed by user or group ID
+    void take(GroupKey by, std::vector<Aggregate>& rows) {
+        for (size_t i = 0; i < rows_.size(); i++) {
+            if (by == GROUP_USER) rows_[i].key = uid2name(row_ids_[i]);
+            if (by == GROUP_GROUP) rows_[i].key = gid2name(row_ids_[i]);
+        }
+        rows = std::move(rows_);
+    }
+
+private:
+    static const uint32_t NO_ROW = 0xffffffff;
+
+    Aggregate& add_row(uint32_t id) {
+        rows_.push_back(Aggregate());
+        row_ids_.push_back(id);
+        return rows_.back();
+    }
+
+    uint32_t name_row(const char *name) {
+        StringPool::Id id = names_.intern(name);
+        if (id >= name_rows_.size()) name_rows_.resize(id + 1, NO_ROW);
+        if (name_rows_[id] == NO_ROW) {
+            name_rows_[id] = rows_.size();
+            add_row(0).key = name ? name : "";
+        }
+        return name_rows_[id];
+    }
+
+    // Only lists which have a comma are copied apart
+    void split(const char *list, std::vector<uint32_t>& rows) {
+        if (!list || !std::strchr(list, ',')) {
+            rows.push_back(name_row(list));
+            return;
+        }
+        std::vector<std::string> elements = split_list(list);
+        if (elements.empty()) rows.push_back(name_row(nullptr));
+        for (const std::string& element : elements) {
+            if (elements_.matches(element.c_str())) rows.push_back(name_row(element.c_str()));
+        }
+    }
+
+    const StringFilter& elements_;
+    std::unordered_map<uint32_t, uint32_t> ids_;
+    StringPool names_;
+    std::vector<uint32_t> name_rows_;
+    std::vector<std::vector<uint32_t>> slots_;
+    std::vector<uint32_t> split_;
+    std::vector<Aggregate> rows_;
+    std::vector<uint32_t> row_ids_;
+};
+
+const uint32_t AggregateRows::NO_ROW;
+
+
+// The core-hours a job has left: the rest of a running job's time, or a pending job's whole
+// time limit
+static double remaining_core_hours(Category cat, uint32_t cpus, uint32_t time_limit,
+        std::time_t end_time, std::time_t now) {
+    if (cat == CATEGORY_RUNNING) return cpus * (std::max<std::time_t>(0, end_time - now) / 3600.0);
+    if (time_limit == NO_VAL || time_limit == INFINITE) return 0;
+    return cpus * (time_limit / 60.0);
+}
+
+
+static void add_job(Aggregate& row, Category cat, uint32_t cpus, uint32_t nodes, double core_hours) {
+    row.summary.jobs[cat]++;
+    row.summary.cores[cat] += cpus;
+    row.summary.nodes[cat] += nodes;
+    row.core_hours += core_hours;
+}
+
+
+void aggregate_jobs(const Options& opts, const job_info_msg_t *records, std::vector<Aggregate>& rows,
+        unsigned long& jobs) {
+    Categorizer categorize(opts.blocked_reasons);
+    AggregateRows index(opts.partition);
+    std::time_t now = std::time(nullptr);
+    jobs = 0;
+    for (unsigned i = 0; i < records->record_count; i++) {
+        const job_info_t& job = records->job_array[i];
+        if (!selected_job(opts, job)) continue;
+        Category cat = categorize(job.job_state, job.state_reason);
+        if (cat == CATEGORY_COMPLETE) continue;
+
+        jobs++;
+        double core_hours = remaining_core_hours(cat, job.num_cpus, job.time_limit, job.end_time, now);
+        if (opts.by == GROUP_PARTITION) {
+            for (uint32_t row : index.names(job.partition)) {
+                add_job(index[row], cat, job.num_cpus, job.num_nodes, core_hours);
+            }
+            continue;
+        }
+        Aggregate& row = opts.by == GROUP_USER ? index.id(job.user_id)
+            : opts.by == GROUP_GROUP ? index.id(job.group_id)
+            : opts.by == GROUP_ACCOUNT ? index.name(job.account)
+            : index.name(job.qos);
+        add_job(row, cat, job.num_cpus, job.num_nodes, core_hours);
+    }
+    index.take(opts.by, rows);
+}
+
+
+void aggregate_jobs(const Options& opts, const JobTable& jobs, std::vector<Aggregate>& rows,
+        unsigned long& count) {
+    Categorizer categorize(opts.blocked_reasons);
+    Selection selection(opts, jobs);
+    AggregateRows index(opts.partition);
+    std::time_t now = std::time(nullptr);
+    const StringColumn& column = opts.by == GROUP_ACCOUNT ? jobs.account
+        : opts.by == GROUP_PARTITION ? jobs.partition
+        : jobs.qos;
+    count = 0;
+    for (uint32_t row = 0; row < jobs.size(); row++) {
+        if (!selected_row(opts, selection, jobs, row)) continue;
+        Category cat = categorize(jobs.job_state[row], jobs.state_reason[row]);
+        if (cat == CATEGORY_COMPLETE) continue;
+
+        count++;
+        double core_hours = remaining_core_hours(cat, jobs.num_cpus[row], jobs.time_limit[row],
+            jobs.end_time[row], now);
+        if (opts.by == GROUP_USER || opts.by == GROUP_GROUP) {
+            Aggregate& totals = index.id(opts.by == GROUP_USER ? jobs.user_id[row] : jobs.group_id[row]);
+            add_job(totals, cat, jobs.num_cpus[row], jobs.num_nodes[row], core_hours);
+            continue;
+        }
+        for (uint32_t i : index.slot(column.id(row), column[row], opts.by == GROUP_PARTITION)) {
+            add_job(index[i], cat, jobs.num_cpus[row], jobs.num_nodes[row], core_hours);
+        }
+    }
+    index.take(opts.by, rows);
+}
+
+
+static unsigned long active_total(const unsigned long *counts) {
+    return counts[CATEGORY_RUNNING] + counts[CATEGORY_IDLE] + counts[CATEGORY_BLOCKED];
+}
+
+
+static double aggregate_value(AggregateKey key, const Aggregate& row) {
+    switch (key) {
+        case AGGREGATE_JOBS: return active_total(row.summary.jobs);
+        case AGGREGATE_ACTIVE: return row.summary.jobs[CATEGORY_RUNNING];
+        case AGGREGATE_ELIGIBLE: return row.summary.jobs[CATEGORY_IDLE];
+        case AGGREGATE_BLOCKED: return row.summary.jobs[CATEGORY_BLOCKED];
+        case AGGREGATE_CORES: return active_total(row.summary.cores);
+        case AGGREGATE_NODES: return active_total(row.summary.nodes);
+        case AGGREGATE_COREHOURS: return row.core_hours;
+        default: return 0;
+    }
+}
+
+
+void sort_aggregates(const Options& opts, std::vector<Aggregate>& rows) {
+    auto before = [&](const Aggregate& a, const Aggregate& b) {
+        for (AggregateKey key : opts.by_order) {
+            if (key == AGGREGATE_KEY) {
+                if (a.key != b.key) return a.key < b.key;
+                continue;
+            }
+            double x = aggregate_value(key, a), y = aggregate_value(key, b);
+            if (x != y) return x > y;
+        }
+        return a.key < b.key;
+    };
+    if (opts.limit && opts.limit < rows.size()) {
+        std::partial_sort(rows.begin(), rows.begin() + opts.limit, rows.end(), before);
+    } else {
+        std::sort(rows.begin(), rows.end(), before);
+    }
+}
+
+
+// A set of nodes, stored as a bitmap indexed by position in the node table
+class NodeSet {
+public:
+    // Add the nodes in a Slurm node_inx array: pairs of first and last indexes ending in -1
+    void add(const int32_t *inx) {
+        for (; inx[0] >= 0 && inx[1] >= inx[0]; inx += 2) {
+            add_range(inx[0], inx[1]);
+        }
+    }
+
+    int count() const {
+        int n = 0;
+        for (uint64_t word : words_) n += __builtin_popcountll(word);
+        return n;
+    }
+
+private:
+    void add_range(uint32_t first, uint32_t last) {
+        if (last / 64 >= words_.size()) words_.resize(last / 64 + 1);
+        uint32_t first_word = first / 64, last_word = last / 64;
+        uint64_t first_mask = ~uint64_t(0) << (first % 64);
+        uint64_t last_mask = ~uint64_t(0) >> (63 - last % 64);
+        if (first_word == last_word) {
+            words_[first_word] |= first_mask & last_mask;
+            return;
+        }
+        words_[first_word] |= first_mask;
+        for (uint32_t w = first_word + 1; w < last_word; w++) words_[w] = ~uint64_t(0);
+        words_[last_word] |= last_mask;
+    }
+
+    std::vector<uint64_t> words_;
+};
+
+
+static bool selected_partition(const Options& opts, const partition_info_t *part) {
+    return opts.partition.matches(part->name);
+}
+
+
+// Count nodes by expanding and deduplicating their hostlists, for tables without node indexes
+static void count_hostlists(const Options& opts, const partition_info_msg_t *partitions,
+        JobBuckets& buckets) {
+    // Collect nodes used by running jobs
+    hostlist_t running_nodes = slurm_hostlist_create("");
+    for (uint32_t row : buckets.running) {
+        slurm_hostlist_push(running_nodes, buckets.table->nodes[row]);
+    }
+
+    // Collect nodes in the relevant partition(s) for utilization stats
+    hostlist_t partition_nodes = slurm_hostlist_create("");
+    for (unsigned i = 0; i < partitions->record_count; i++) {
+        partition_info_t *part_ptr = &partitions->partition_array[i];
+        if (!selected_partition(opts, part_ptr)) continue;
+        slurm_hostlist_push(partition_nodes, part_ptr->nodes);
+    }
+    
+    // Filter duplicate entries and get the final counts
+    slurm_hostlist_uniq(running_nodes);
+    slurm_hostlist_uniq(partition_nodes);
+    buckets.running_nodes = slurm_hostlist_count(running_nodes);
+    buckets.partition_nodes = slurm_hostlist_count(partition_nodes);
+    slurm_hostlist_destroy(running_nodes);
+    slurm_hostlist_destroy(partition_nodes);
+}
+
+
+void count_utilization(const Options& opts, const partition_info_msg_t *partitions,
+        JobBuckets& buckets) {
+    // Jobs and partitions carry the node table indexes of their nodes, so the counts are
+    // just the sizes of the unions of those index ranges. If any are missing, fall back
+    // to parsing the hostlists.
+    NodeSet running_nodes, partition_nodes;
+    const JobTable& jobs = *buckets.table;
+    for (uint32_t row : buckets.running) {
+        if (jobs.node_inx(row)) {
+            running_nodes.add(jobs.node_inx(row));
+        } else if (jobs.nodes[row] && *jobs.nodes[row]) {
+            count_hostlists(opts, partitions, buckets);
+            return;
+        }
+    }
+    for (unsigned i = 0; i < partitions->record_count; i++) {
+        partition_info_t *part_ptr = &partitions->partition_array[i];
+        if (!selected_partition(opts, part_ptr)) continue;
+        if (part_ptr->node_inx) {
+            partition_nodes.add(part_ptr->node_inx);
+        } else if (part_ptr->nodes && *part_ptr->nodes) {
+            count_hostlists(opts, partitions, buckets);
+            return;
+        }
+    }
+    buckets.running_nodes = running_nodes.count();
+    buckets.partition_nodes = partition_nodes.count();
+}
+
+
+// The number of tasks in a range expression like "1-5,9,12-20:2%4", where the limit on tasks
+// running at once ends it
+static unsigned long count_tasks(const char *spec) {
+    unsigned long count = 0;
+    const char *p = spec;
+    while (std::isdigit(static_cast<unsigned char>(*p))) {
+        char *end;
+        unsigned long first = std::strtoul(p, &end, 10), last = first, step = 1;
+        if (*end == '-') last = std::strtoul(end + 1, &end, 10);
+        if (*end == ':') step = std::max(1ul, std::strtoul(end + 1, &end, 10));
+        if (last >= first) count += (last - first) / step + 1;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+
+// Append sorted task IDs to a range expression, coalescing consecutive IDs
+static void append_ranges(std::string& out, const std::vector<uint32_t>& tasks) {
+    for (size_t i = 0; i < tasks.size(); ) {
+        size_t j = i;
+        while (j + 1 < tasks.size() && tasks[j + 1] == tasks[j] + 1) j++;
+        if (!out.empty()) out += ',';
+        out += std::to_string(tasks[i]);
+        if (j > i) out += '-' + std::to_string(tasks[j]);
+        i = j + 1;
+    }
+}
+
+
+// The rows of one job array in a section: tasks Slurm lists on their own, and the ranges of
+// tasks it still holds in the array's own record
+struct ArrayGroup {
+    uint32_t row;
+    std::vector<uint32_t> tasks;
+    std::string pending;
+    unsigned long pending_count = 0;
+};
+
+
+// Group each section's rows by array ID in one pass, keeping the first row of each group in
+// place. A group which is only a single task is left as it is.
+static void compact_section(const JobTable& jobs, std::vector<uint32_t>& rows, ArrayRows& arrays) {
+    std::unordered_map<uint32_t, size_t> index;
+    std::vector<ArrayGroup> groups;
+    size_t kept = 0;
+    for (uint32_t row : rows) {
+        uint32_t array = jobs.array_job_id[row];
+        if (!array) {
+            rows[kept++] = row;
+            continue;
+        }
+        auto found = index.emplace(array, groups.size());
+        if (found.second) {
+            groups.push_back(ArrayGroup());
+            groups.back().row = row;
+            rows[kept++] = row;
+        }
+        ArrayGroup& group = groups[found.first->second];
+        uint32_t task = jobs.array_task_id[row];
+        const char *pending = jobs.array_task_str[row];
+        if (task != NO_VAL) {
+            group.tasks.push_back(task);
+        } else if (pending && *pending) {
+            if (!group.pending.empty()) group.pending += ',';
+            group.pending += pending;
+            group.pending_count += count_tasks(pending);
+        }
+    }
+    rows.resize(kept);
+
+    for (ArrayGroup& group : groups) {
+        if (group.pending.empty() && group.tasks.size() < 2) continue;
+        if (!std::is_sorted(group.tasks.begin(), group.tasks.end())) {
+            std::sort(group.tasks.begin(), group.tasks.end());
+        }
+        group.tasks.erase(std::unique(group.tasks.begin(), group.tasks.end()), group.tasks.end());
+        ArrayTasks& tasks = arrays[group.row];
+        append_ranges(tasks.tasks, group.tasks);
+        if (!group.pending.empty()) tasks.tasks += (tasks.tasks.empty() ? "" : ",") + group.pending;
+        tasks.count = group.tasks.size() + group.pending_count;
+    }
+}
+
+
+void compact_arrays(JobBuckets& buckets) {
+    for (std::vector<uint32_t> *rows : {&buckets.running, &buckets.idle, &buckets.blocked,
+            &buckets.complete}) {
+        compact_section(*buckets.table, *rows, buckets.arrays);
+    }
+}
+
+
+void sort_jobs(const Options& opts, JobBuckets& buckets) {
+    for (std::vector<uint32_t> *rows : {&buckets.running, &buckets.idle, &buckets.blocked,
+            &buckets.complete}) {
+        sort_rows(*buckets.table, opts.orderby, *rows, opts.limit);
+    }
+}
+
+
+// The columns of each report section, as --format specs
+static const char *COMPLETED_FORMAT = "%-19jobid %-10state{STATUS} %-6exitcode %3.3partition %7xfactor "
+    "%2.2qos %9user %9group %16mhost %5procs %11walltime  %21endtime{COMPLETIONTIME}";
+static const char *RUNNING_FORMAT = "%-19jobid %-10state{STATUS} %3.3partition %7xfactor %2.2qos "
+    "%9user %9group %16mhost %5procs %11remaining  %21starttime";
+static const char *IDLE_FORMAT = "%-19jobid %10priority %3.3partition %7xfactor %2.2qos %9user "
+    "%9group %5procs %11wclimit  %21submittime{SYSTEMQUEUETIME}";
+static const char *BLOCKED_FORMAT = "%-18jobid %8user %8group %10state %5procs %11wclimit  %21submittime";
+static const char *DEFAULT_ACTIVE_FORMAT = "%-18jobid %8user %10state %5procs %11remaining  %21starttime";
+static const char *DEFAULT_QUEUED_FORMAT = "%-18jobid %8user %10state %5procs %11wclimit  %21submittime";
+
+
+// The layout of a section: the user's --format if they gave one, or the section's own
+static Layout section_layout(const Options& opts, const char *spec) {
+    Layout layout;
+    std::string error;
+    layout.compile(opts.format != "" ? opts.format : spec, error);
+    return layout;
+}
+
+
+// The number of a section's jobs to show
+static size_t shown(size_t limit, const std::vector<uint32_t>& rows) {
+    return limit ? std::min(limit, rows.size()) : rows.size();
+}
+
+
+// Append a section's column header and a line for each of its jobs, up to limit if it is set,
+// with the job's nodes under it if nodes is set
+static void render_rows(OutputBuffer& out, RowContext& ctx, const Layout& layout,
+        const std::vector<uint32_t>& rows, size_t limit, bool nodes) {
+    layout.header(out);
+    out.str("\n\n");
+    for (size_t i = 0, count = shown(limit, rows); i < count; i++) {
+        uint32_t row = rows[i];
+        layout.row(out, ctx, row);
+        out.chr('\n');
+        if (nodes) {
+            const char *list = ctx.jobs.nodes[row];
+            out.str("    Nodes: ").str(list ? list : "(null)").chr('\n');
+        }
+    }
+}
+
+
+// The utilization line, formatted the way iostreams print with a precision of 2
+static OutputBuffer& utilization_line(OutputBuffer& out, const JobBuckets& buckets) {
+    char percent[32];
+    int len = std::snprintf(percent, sizeof(percent), "%.2g",
+        static_cast<double>(buckets.running_nodes) / buckets.partition_nodes * 100);
+    return out.chr('\n').num(buckets.running_jobs).str(" active jobs\t\t")
+        .num(buckets.running_nodes).str(" of ").num(buckets.partition_nodes)
+        .str(" nodes active      (").str(percent, len).str("%)");
+}
+
+
+// Write the jobs in a report's sections as records, in the order the text report lists them
+static void render_records(const Options& opts, const JobBuckets& buckets) {
+    struct Section {
+        Category cat;
+        const std::vector<uint32_t>& rows;
+    };
+    std::vector<Section> sections;
+    if (opts.report == REPORT_COMPLETED) sections.push_back({CATEGORY_COMPLETE, buckets.complete});
+    if (opts.report == REPORT_RUNNING || opts.report == REPORT_DEFAULT) {
+        sections.push_back({CATEGORY_RUNNING, buckets.running});
+    }
+    if (opts.report == REPORT_IDLE || opts.report == REPORT_DEFAULT) {
+        sections.push_back({CATEGORY_IDLE, buckets.idle});
+    }
+    if (opts.report == REPORT_BLOCKED || opts.report == REPORT_DEFAULT) {
+        sections.push_back({CATEGORY_BLOCKED, buckets.blocked});
+    }
+
+    OutputBuffer out;
+    RecordWriter writer(out, opts.output, job_record_fields());
+    for (const Section& section : sections) {
+        for (size_t i = 0, count = shown(opts.limit, section.rows); i < count; i++) {
+            uint32_t row = section.rows[i];
+            auto array = buckets.arrays.find(row);
+            write_job(writer, SECTION_NAMES[section.cat], *buckets.table, row,
+                array == buckets.arrays.end() ? nullptr : &array->second);
+        }
+    }
+    writer.finish();
+}
+
+
+void render_report(const Options& opts, const JobBuckets& buckets) {
+    if (opts.output != OUTPUT_TEXT) {
+        render_records(opts, buckets);
+        return;
+    }
+
+    OutputBuffer out;
+    RowContext ctx(*buckets.table, opts.jobname);
+    ctx.arrays = &buckets.arrays;
+
+    // Print the requested report
+    if (opts.report == REPORT_COMPLETED) {
+        out.str("\ncompleted jobs---------------------\n");
+        render_rows(out, ctx, section_layout(opts, COMPLETED_FORMAT), buckets.complete, opts.limit,
+            opts.nodes);
+        out.chr('\n').num(buckets.complete_jobs).str(" completed jobs\n\nTotal jobs: ")
+            .num(buckets.complete_jobs).str("\n\n");
+        return;
+    } 
+    
+    if (opts.report == REPORT_RUNNING) {
+        out.str("\nactive jobs------------------------\n");
+        render_rows(out, ctx, section_layout(opts, RUNNING_FORMAT), buckets.running, opts.limit,
+            opts.nodes);
+        utilization_line(out, buckets).str("\n\nTotal jobs: ").num(buckets.running_jobs)
+            .str("\n\n");
+        return;
+    } 
+    
+    if (opts.report == REPORT_IDLE) {
+        out.str("\neligible jobs----------------------\n");
+        render_rows(out, ctx, section_layout(opts, IDLE_FORMAT), buckets.idle, opts.limit, false);
+        out.chr('\n').num(buckets.idle_jobs).str(" eligible jobs\n\nTotal jobs: ")
+            .num(buckets.idle_jobs).str("\n\n");
+        return;
+
+    } 
+    
+    if (opts.report == REPORT_BLOCKED) {
+        out.str("\nblocked jobs-----------------------\n");
+        render_rows(out, ctx, section_layout(opts, BLOCKED_FORMAT), buckets.blocked, opts.limit, false);
+        out.chr('\n').num(buckets.blocked_jobs).str(" blocked jobs\n\nTotal jobs: ")
+            .num(buckets.blocked_jobs).str("\n\n");
+        return;
+    }
+    
+    out.str("\nactive jobs------------------------\n");
+    render_rows(out, ctx, section_layout(opts, DEFAULT_ACTIVE_FORMAT), buckets.running, opts.limit,
+        opts.nodes);
+    utilization_line(out, buckets);
+
+    Layout queued = section_layout(opts, DEFAULT_QUEUED_FORMAT);
+    out.str("\n\neligible jobs----------------------\n");
+    render_rows(out, ctx, queued, buckets.idle, opts.limit, false);
+    out.chr('\n').num(buckets.idle_jobs).str(" eligible jobs");
+
+    out.str("\n\nblocked jobs-----------------------\n");
+    render_rows(out, ctx, queued, buckets.blocked, opts.limit, false);
+    out.chr('\n').num(buckets.blocked_jobs).str(" blocked jobs\n\nTotal jobs: ")
+        .num(buckets.blocked_jobs + buckets.idle_jobs + buckets.running_jobs).str("\n\n");
+}
+
+
+// One line of the summary: a count for each active section
+static void summary_line(OutputBuffer& out, const char *what, const unsigned long *counts) {
+    out.str("active ").str(what).str(": ").num(counts[CATEGORY_RUNNING])
+        .str("  eligible ").str(what).str(": ").num(counts[CATEGORY_IDLE])
+        .str("  blocked ").str(what).str(": ").num(counts[CATEGORY_BLOCKED]).chr('\n');
+}
+
+
+void render_summary(const Options& opts, const Summary& summary) {
+    OutputBuffer out;
+    if (opts.output != OUTPUT_TEXT) {
+        RecordWriter writer(out, opts.output, {"section", "jobs", "cores", "nodes"});
+        for (Category cat : {CATEGORY_RUNNING, CATEGORY_IDLE, CATEGORY_BLOCKED}) {
+            writer.begin_record();
+            writer.value(SECTION_NAMES[cat]).value(summary.jobs[cat]).value(summary.cores[cat])
+                .value(summary.nodes[cat]);
+            writer.end_record();
+        }
+        writer.finish();
+        return;
+    }
+
+    out.chr('\n');
+    summary_line(out, "jobs", summary.jobs);
+    summary_line(out, "cores", summary.cores);
+    summary_line(out, "nodes", summary.nodes);
+    out.str("\nTotal jobs: ")
+        .num(summary.jobs[CATEGORY_RUNNING] + summary.jobs[CATEGORY_IDLE] + summary.jobs[CATEGORY_BLOCKED])
+        .str("\n\n");
+}
+
+
+void render_aggregates(const Options& opts, const std::vector<Aggregate>& rows, unsigned long jobs) {
+    OutputBuffer out;
+    size_t count = opts.limit ? std::min(opts.limit, rows.size()) : rows.size();
+    if (opts.output != OUTPUT_TEXT) {
+        RecordWriter writer(out, opts.output, {GROUP_KEY_NAMES[opts.by], "active_jobs",
+            "eligible_jobs", "blocked_jobs", "active_cores", "eligible_cores", "blocked_cores",
+            "active_nodes", "eligible_nodes", "blocked_nodes", "core_hours"});
+        for (size_t i = 0; i < count; i++) {
+            const Summary& s = rows[i].summary;
+            writer.begin_record();
+            writer.value(rows[i].key.c_str());
+            for (const unsigned long *counts : {s.jobs, s.cores, s.nodes}) {
+                writer.value(counts[CATEGORY_RUNNING]).value(counts[CATEGORY_IDLE])
+                    .value(counts[CATEGORY_BLOCKED]);
+            }
+            writer.fixed_value(rows[i].core_hours);
+            writer.end_record();
+        }
+        writer.finish();
+        return;
+    }
+
+    std::string title = GROUP_KEY_NAMES[opts.by];
+    std::transform(title.begin(), title.end(), title.begin(), toupper);
+    out.chr('\n').left(title, 16).str("   ACTIVE  ELIGIBLE   BLOCKED     CORES     NODES   CORE-HOURS\n\n");
+    for (size_t i = 0; i < count; i++) {
+        const Aggregate& row = rows[i];
+        out.left(row.key.empty() ? "(none)" : row.key.c_str(), 16, 16).chr(' ')
+            .right(row.summary.jobs[CATEGORY_RUNNING], 8).chr(' ')
+            .right(row.summary.jobs[CATEGORY_IDLE], 9).chr(' ')
+            .right(row.summary.jobs[CATEGORY_BLOCKED], 9).chr(' ')
+            .right(active_total(row.summary.cores), 9).chr(' ')
+            .right(active_total(row.summary.nodes), 9).chr(' ')
+            .fixed1(row.core_hours, 12).chr('\n');
+    }
+    out.chr('\n').num(rows.size()).chr(' ').str(GROUP_PLURALS[opts.by]).str("\n\nTotal jobs: ")
+        .num(jobs).str("\n\n");
+}
+
+
+// The number of job rows a report prints
+static size_t rendered_rows(const Options& opts, const JobBuckets& buckets) {
+    switch (opts.report) {
+        case REPORT_COMPLETED: return shown(opts.limit, buckets.complete);
+        case REPORT_RUNNING: return shown(opts.limit, buckets.running);
+        case REPORT_IDLE: return shown(opts.limit, buckets.idle);
+        case REPORT_BLOCKED: return shown(opts.limit, buckets.blocked);
+        default:
+            return shown(opts.limit, buckets.running) + shown(opts.limit, buckets.idle)
+                + shown(opts.limit, buckets.blocked);
+    }
+}
+
+
+void print_report(const Options& opts, JobSource& data) {
+    // The grouped report and the summary only count, so they skip collecting, sorting, and
+    // rendering jobs
+    if (opts.report == REPORT_GROUPED) {
+        std::vector<Aggregate> rows;
+        unsigned long jobs = 0;
+        {
+            ScopedTimer timer("aggregate");
+            if (const job_info_msg_t *records = data.job_records()) {
+                aggregate_jobs(opts, records, rows, jobs);
+                timer.records(records->record_count);
+            } else {
+                const JobTable *table = data.jobs();
+                aggregate_jobs(opts, *table, rows, jobs);
+                timer.records(table->size());
+            }
+        }
+        {
+            ScopedTimer timer("sort");
+            sort_aggregates(opts, rows);
+            timer.records(rows.size());
+        }
+        ScopedTimer timer("render");
+        render_aggregates(opts, rows, jobs);
+        timer.records(rows.size());
+        return;
+    }
+    if (opts.report == REPORT_SUMMARY) {
+        Summary summary;
+        {
+            ScopedTimer timer("summary");
+            if (const job_info_msg_t *records = data.job_records()) {
+                summarize_jobs(opts, records, summary);
+                timer.records(records->record_count);
+            } else {
+                const JobTable *jobs = data.jobs();
+                summarize_jobs(opts, *jobs, summary);
+                timer.records(jobs->size());
+            }
+        }
+        ScopedTimer timer("render");
+        render_summary(opts, summary);
+        return;
+    }
+
+    JobBuckets buckets;
+    {
+        ScopedTimer timer("classify");
+        const JobTable *jobs = data.jobs();
+        classify_jobs(opts, *jobs, buckets);
+        timer.records(jobs->size());
+    }
+    if (report_tables(opts.report) & TABLE_PARTITIONS) {
+        ScopedTimer timer("utilization");
+        partition_info_msg_t *partitions = data.partitions();
+        count_utilization(opts, partitions, buckets);
+        timer.records(buckets.running.size() + partitions->record_count);
+    }
+    if (!opts.expand_arrays) {
+        ScopedTimer timer("arrays");
+        compact_arrays(buckets);
+        timer.records(buckets.running_jobs + buckets.idle_jobs + buckets.blocked_jobs
+            + buckets.complete_jobs);
+    }
+    {
+        ScopedTimer timer("sort");
+        sort_jobs(opts, buckets);
+        timer.records(opts.orderby.empty() ? 0 : buckets.running.size() + buckets.idle.size()
+            + buckets.blocked.size() + buckets.complete.size());
+    }
+    {
+        ScopedTimer timer("render");
+        render_report(opts, buckets);
+        timer.records(rendered_rows(opts, buckets));
+    }
+}
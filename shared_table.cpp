@@ -0,0 +1,317 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "fcntl.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "unistd.h"
+
+#include "profile.hpp"
+#include "shared_table.hpp"
+
+
+static const char SHARED_MAGIC[8] = {'S', 'H', 'O', 'W', 'Q', 'S', 'H', 'M'};
+static const uint32_t SHARED_VERSION = 1;
+
+// Arrays start on cache line boundaries
+static const size_t SHARED_ALIGN = 64;
+
+
+struct SharedArray {
+    uint64_t offset, count;
+};
+
+
+static size_t align(size_t offset) {
+    return (offset + SHARED_ALIGN - 1) & ~(SHARED_ALIGN - 1);
+}
+
+
+// The number of arrays a JobTable has
+struct CountArrays {
+    uint32_t count = 0;
+
+    template <typename T>
+    void operator()(const Array<T>&) { count++; }
+};
+
+
+static uint32_t table_arrays() {
+    CountArrays counter;
+    JobTable().visit(counter);
+    return counter.count;
+}
+
+
+// Lays a table's arrays out one after another, then copies them into the region
+struct WriteArrays {
+    size_t offset;
+    std::vector<SharedArray> arrays;
+    std::vector<const void *> sources;
+    std::vector<size_t> bytes;
+
+    template <typename T>
+    void operator()(const Array<T>& array) {
+        offset = align(offset);
+        arrays.push_back({offset, array.size()});
+        sources.push_back(array.data());
+        bytes.push_back(array.size() * sizeof(T));
+        offset += bytes.back();
+    }
+
+    void copy(char *region) const {
+        for (size_t i = 0; i < arrays.size(); i++) {
+            if (bytes[i]) std::memcpy(region + arrays[i].offset, sources[i], bytes[i]);
+        }
+    }
+};
+
+
+// Points a table's arrays into the region, checking that each one fits inside it
+struct ViewArrays {
+    ViewArrays(const char *region, size_t size, const SharedArray *arrays)
+        : region(region), size(size), arrays(arrays) {}
+
+    const char *region;
+    size_t size;
+    const SharedArray *arrays;
+    uint32_t next = 0;
+    bool ok = true;
+
+    template <typename T>
+    void operator()(Array<T>& array) {
+        const SharedArray& a = arrays[next++];
+        if (a.offset % SHARED_ALIGN || a.offset > size || a.count > (size - a.offset) / sizeof(T)) {
+            ok = false;
+            return;
+        }
+        array.view(reinterpret_cast<const T *>(region + a.offset), a.count);
+    }
+};
+
+
+// The seqlock's reader side: retry until the heartbeat is read between two equal, even
+// sequence numbers. A showqd killed mid-update leaves the sequence odd, so give up eventually
+// and call the tables stale.
+static std::time_t read_heartbeat(const SharedTableHeader *header) {
+    for (int attempt = 0; attempt < 1000000; attempt++) {
+        uint64_t before = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+        int64_t heartbeat = __atomic_load_n(&header->heartbeat, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t after = __atomic_load_n(&header->sequence, __ATOMIC_RELAXED);
+        if (before == after && !(before & 1)) return heartbeat;
+    }
+    return 0;
+}
+
+
+// Anyone can write to /dev/shm, so only trust tables which root, this user, or showqd (as the
+// owner of its socket) wrote, and which nobody else can change
+static bool trusted(const struct stat& st, const std::string& socket) {
+    if (!S_ISREG(st.st_mode) || st.st_mode & (S_IWGRP | S_IWOTH)) return false;
+    if (st.st_uid == 0 || st.st_uid == geteuid()) return true;
+    struct stat server;
+    return socket != "" && stat(socket.c_str(), &server) == 0 && S_ISSOCK(server.st_mode)
+        && server.st_uid == st.st_uid;
+}
+
+
+static bool fresh(const SharedTableHeader *header) {
+    return std::time(nullptr) - read_heartbeat(header) <= STALE_INTERVALS * header->interval;
+}
+
+
+SharedTablePublisher::~SharedTablePublisher() {
+    if (header_) munmap(header_, size_);
+}
+
+
+bool SharedTablePublisher::prepare(std::string& error) {
+    size_t slash = path_.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path_.substr(0, slash);
+    if (mkdir(dir.c_str(), 0755) && errno != EEXIST) {
+        error = "Unable to create " + dir + ": " + std::strerror(errno);
+        return false;
+    }
+
+    // Other users mustn't be able to replace the tables: the directory has to be ours or
+    // root's, and only writable by its owner unless it's sticky, like /dev/shm
+    struct stat st;
+    if (lstat(dir.c_str(), &st) || !S_ISDIR(st.st_mode)) {
+        error = dir + " is not a directory";
+        return false;
+    }
+    if ((st.st_uid != geteuid() && st.st_uid != 0)
+            || (st.st_mode & (S_IWGRP | S_IWOTH) && !(st.st_mode & S_ISVTX))) {
+        error = dir + " is owned or writable by another user";
+        return false;
+    }
+    if (lstat(path_.c_str(), &st) == 0 && (!S_ISREG(st.st_mode) || st.st_uid != geteuid())) {
+        error = path_ + " already exists and wasn't written by this showqd; remove it or choose "
+            "another --shm";
+        return false;
+    }
+    return true;
+}
+
+
+bool SharedTablePublisher::publish(const JobTable& jobs, const partition_info_msg_t *partitions) {
+    ScopedTimer timer("publish");
+    std::vector<char> snapshot = serialize_snapshot(nullptr, partitions, nullptr);
+    WriteArrays layout;
+    layout.offset = sizeof(SharedTableHeader) + table_arrays() * sizeof(SharedArray);
+    jobs.visit(layout);
+    size_t partitions_offset = align(layout.offset);
+    size_t size = partitions_offset + snapshot.size();
+
+    // Other users can create files in /dev/shm too, so never open a name they could predict
+    std::vector<char> temp(path_.begin(), path_.end());
+    const char suffix[] = ".XXXXXX";
+    temp.insert(temp.end(), suffix, suffix + sizeof(suffix));
+    int fd = mkstemp(temp.data());
+    if (fd < 0) return false;
+    void *region = MAP_FAILED;
+    if (fchmod(fd, 0644) == 0 && ftruncate(fd, size) == 0) {
+        region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (region == MAP_FAILED) {
+        unlink(temp.data());
+        return false;
+    }
+
+    char *bytes = static_cast<char *>(region);
+    layout.copy(bytes);
+    std::memcpy(bytes + sizeof(SharedTableHeader), layout.arrays.data(),
+        layout.arrays.size() * sizeof(SharedArray));
+    std::memcpy(bytes + partitions_offset, snapshot.data(), snapshot.size());
+
+    SharedTableHeader *header = static_cast<SharedTableHeader *>(region);
+    std::memcpy(header->magic, SHARED_MAGIC, sizeof(SHARED_MAGIC));
+    header->version = SHARED_VERSION;
+    header->arrays = layout.arrays.size();
+    header->size = size;
+    header->sequence = 0;
+    header->heartbeat = std::time(nullptr);
+    header->interval = interval_;
+    header->jobs = jobs.size();
+    header->last_update = jobs.last_update;
+    header->partitions = partitions_offset;
+    header->partitions_size = snapshot.size();
+
+    if (rename(temp.data(), path_.c_str())) {
+        munmap(region, size);
+        unlink(temp.data());
+        return false;
+    }
+
+    // Keep the new region mapped for its heartbeats
+    if (header_) munmap(header_, size_);
+    header_ = header;
+    size_ = size;
+    timer.records(jobs.size());
+    return true;
+}
+
+
+void SharedTablePublisher::heartbeat() {
+    if (!header_) return;
+    uint64_t sequence = header_->sequence;
+    __atomic_store_n(&header_->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&header_->heartbeat, static_cast<int64_t>(std::time(nullptr)), __ATOMIC_RELAXED);
+    __atomic_store_n(&header_->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+
+SharedJobSource::~SharedJobSource() {
+    unmap();
+}
+
+
+void SharedJobSource::unmap() {
+    jobs_.reset();
+    if (region_) munmap(const_cast<char *>(region_), size_);
+    region_ = nullptr;
+    size_ = 0;
+}
+
+
+bool SharedJobSource::refresh(unsigned tables, bool& changed) {
+    changed = false;
+    struct stat st;
+    if (stat(path_.c_str(), &st)) return false;
+    if (region_ && st.st_dev == dev_ && st.st_ino == ino_) {
+        // The same tables, as long as showqd is still looking after them
+        return fresh(reinterpret_cast<const SharedTableHeader *>(region_));
+    }
+    if (!read()) return false;
+    changed = true;
+    return load(tables);
+}
+
+
+bool SharedJobSource::read() {
+    ScopedTimer timer("shm");
+    unmap();
+    // Don't block on a FIFO left in its place
+    int fd = open(path_.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) || !trusted(st, socket_)) {
+        close(fd);
+        std::cerr << "Ignoring showqd tables in " << path_ << " not written by showqd" << std::endl;
+        return false;
+    }
+    void *region = MAP_FAILED;
+    if (static_cast<size_t>(st.st_size) >= sizeof(SharedTableHeader)) {
+        region = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (region == MAP_FAILED) return false;
+    region_ = static_cast<const char *>(region);
+    size_ = st.st_size;
+    dev_ = st.st_dev;
+    ino_ = st.st_ino;
+
+    const SharedTableHeader *header = reinterpret_cast<const SharedTableHeader *>(region_);
+    uint32_t arrays = table_arrays();
+    bool ok = std::memcmp(header->magic, SHARED_MAGIC, sizeof(SHARED_MAGIC)) == 0
+        && header->version == SHARED_VERSION
+        && header->arrays == arrays
+        && header->size == size_
+        && sizeof(SharedTableHeader) + arrays * sizeof(SharedArray) <= size_
+        && header->partitions <= size_ && header->partitions_size <= size_ - header->partitions;
+    if (!ok) {
+        std::cerr << "Ignoring invalid showqd tables in " << path_ << std::endl;
+        unmap();
+        return false;
+    }
+
+    // Leave tables showqd has stopped refreshing to the other sources
+    if (!fresh(header)) {
+        unmap();
+        return false;
+    }
+
+    // The partition table is parsed as a snapshot. The jobs are used where they are.
+    const char *partitions = region_ + header->partitions;
+    std::unique_ptr<JobTable> jobs(new JobTable());
+    jobs->last_update = header->last_update;
+    ViewArrays view(region_, size_,
+        reinterpret_cast<const SharedArray *>(region_ + sizeof(SharedTableHeader)));
+    jobs->visit(view);
+    if (!view.ok || jobs->size() != header->jobs || !jobs->valid()
+            || !parse(std::vector<char>(partitions, partitions + header->partitions_size))) {
+        std::cerr << "Ignoring invalid showqd tables in " << path_ << std::endl;
+        jobs.reset();
+        unmap();
+        return false;
+    }
+    jobs_ = std::move(jobs);
+    timer.records(jobs_->size());
+    return true;
+}
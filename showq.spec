@@ -26,8 +26,10 @@ make %{?_smp_mflags}
 mkdir -p %{buildroot}/%{_bindir}
 
 install -m 0755 showq %{buildroot}/%{_bindir}/showq
+ln -s showq %{buildroot}/%{_bindir}/showqd
 
 
 %files
 %{_bindir}/showq
+%{_bindir}/showqd
 
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+#include "sort.hpp"
+
+
+static const char *KEY_NAMES[] = {
+    "REMAINING", "REVERSEREMAINING", "JOB", "USER", "STARTTIME", "PRIORITY", "SUBMITTIME",
+};
+
+
+bool parse_key_list(const std::string& spec, const char *const *begin, const char *const *end,
+        const std::string& kind, std::vector<size_t>& keys, std::string& error) {
+    keys.clear();
+    std::istringstream names(spec);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        std::transform(name.begin(), name.end(), name.begin(), toupper);
+        const char *const *match = std::find_if(begin, end, [&](const char *key) { return name == key; });
+        if (match == end) {
+            error = "Unknown " + kind + ": " + name;
+            return false;
+        }
+        keys.push_back(match - begin);
+    }
+    return true;
+}
+
+
+std::string join_names(const char *const *begin, const char *const *end) {
+    std::string names;
+    for (const char *const *name = begin; name != end; name++) {
+        if (!names.empty()) names += ',';
+        names += *name;
+    }
+    return names;
+}
+
+
+bool parse_sort_keys(const std::string& spec, std::vector<SortKey>& keys, std::string& error) {
+    std::vector<size_t> indexes;
+    if (!parse_key_list(spec, std::begin(KEY_NAMES), std::end(KEY_NAMES), "sort key", indexes, error)) {
+        return false;
+    }
+    keys.clear();
+    for (size_t index : indexes) keys.push_back(static_cast<SortKey>(index));
+    return true;
+}
+
+
+std::string sort_key_names() {
+    return join_names(std::begin(KEY_NAMES), std::end(KEY_NAMES));
+}
+
+
+// Map a signed time onto an unsigned integer with the same order
+static uint64_t time_value(std::time_t t) {
+    return static_cast<uint64_t>(static_cast<int64_t>(t)) ^ (uint64_t(1) << 63);
+}
+
+
+// A key's value for a row, as an unsigned integer which sorts the way the key should
+static uint64_t key_value(SortKey key, const JobTable& jobs, uint32_t row) {
+    switch (key) {
+        case SORT_REMAINING: return time_value(jobs.end_time[row]);
+        case SORT_REVERSEREMAINING: return ~time_value(jobs.end_time[row]);
+        case SORT_JOB: return jobs.job_id[row];
+        case SORT_USER: return jobs.user_id[row];
+        case SORT_STARTTIME: return time_value(jobs.start_time[row]);
+        case SORT_PRIORITY: return ~uint64_t(jobs.priority[row]);  // Highest priority first
+        case SORT_SUBMITTIME: return time_value(jobs.submit_time[row]);
+    }
+    return 0;
+}
+
+
+// A key's values are stored relative to their minimum, in as few bits as their range needs
+struct PackedKey {
+    SortKey key;
+    uint64_t min;
+    unsigned bits, shift;
+    unsigned word;
+};
+
+
+// A row and one word of its packed keys
+struct Keyed {
+    uint64_t key;
+    uint32_t row;
+};
+
+
+static unsigned bit_width(uint64_t value) {
+    return value ? 64 - __builtin_clzll(value) : 0;
+}
+
+
+// Stable LSD radix sort on the low bits of each item's key, a byte at a time
+static void radix_sort(std::vector<Keyed>& items, unsigned bits) {
+    std::vector<Keyed> scratch(items.size());
+    for (unsigned shift = 0; shift < bits; shift += 8) {
+        size_t offsets[257] = {0};
+        for (const Keyed& item : items) offsets[((item.key >> shift) & 0xff) + 1]++;
+        if (std::find(offsets + 1, offsets + 257, items.size()) != offsets + 257) continue;
+        for (unsigned digit = 1; digit < 257; digit++) offsets[digit] += offsets[digit - 1];
+        for (const Keyed& item : items) scratch[offsets[(item.key >> shift) & 0xff]++] = item;
+        items.swap(scratch);
+    }
+}
+
+
+void sort_rows(const JobTable& jobs, const std::vector<SortKey>& keys, std::vector<uint32_t>& rows,
+        size_t limit) {
+    if (keys.empty() || rows.size() < 2) return;
+
+    // Find each key's range over these rows and pack them, most significant first, into as
+    // many 64-bit words as they need
+    std::vector<PackedKey> packed;
+    unsigned words = 1, used = 0;
+    for (SortKey key : keys) {
+        uint64_t min = key_value(key, jobs, rows[0]), max = min;
+        for (uint32_t row : rows) {
+            uint64_t value = key_value(key, jobs, row);
+            min = std::min(min, value);
+            max = std::max(max, value);
+        }
+        PackedKey p = {key, min, bit_width(max - min), 0, 0};
+        if (p.bits == 0) continue;  // Every row ties on this key
+        if (used + p.bits > 64) {
+            words++;
+            used = 0;
+        }
+        p.word = words - 1;
+        used += p.bits;
+        packed.push_back(p);
+    }
+
+    // Within a word, earlier keys take the higher bits
+    std::vector<unsigned> word_bits(words, 0);
+    for (auto p = packed.rbegin(); p != packed.rend(); ++p) {
+        p->shift = word_bits[p->word];
+        word_bits[p->word] += p->bits;
+    }
+
+    std::vector<Keyed> items(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) items[i].row = rows[i];
+
+    // Sort by the least significant word first. Each pass is stable, so rows which tie on a
+    // word keep the order of the passes before it, and rows which tie on every key keep their
+    // original order.
+    for (unsigned word = words; word-- > 0; ) {
+        for (Keyed& item : items) {
+            item.key = 0;
+            for (const PackedKey& p : packed) {
+                if (p.word == word) item.key |= (key_value(p.key, jobs, item.row) - p.min) << p.shift;
+            }
+        }
+
+        // A single word with a small limit only needs its first rows selected and ordered.
+        // Rows start in table order, so breaking ties by row matches the stable sort.
+        if (words == 1 && limit && limit < items.size() / 8) {
+            std::partial_sort(items.begin(), items.begin() + limit, items.end(),
+                [](const Keyed& a, const Keyed& b) {
+                    return a.key < b.key || (a.key == b.key && a.row < b.row);
+                });
+        } else {
+            radix_sort(items, word_bits[word]);
+        }
+    }
+
+    for (size_t i = 0; i < items.size(); i++) rows[i] = items[i].row;
+}